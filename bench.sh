@@ -0,0 +1,48 @@
+# make bench: starts a private Xvfb and dael (or BENCH_DAEL) on it and
+# runs daelbench, printing one line per scenario. Extra arguments go to
+# daelbench.
+set -e
+BENCH_DISPLAY=${BENCH_DISPLAY:-:101}
+BENCH_DAEL=${BENCH_DAEL:-./dael}
+XVFB=$(whereis -b Xvfb | cut -f2 -d' ')
+RUNTIME=$(mktemp -d)
+export XDG_RUNTIME_DIR="$RUNTIME"
+export DISPLAY="$BENCH_DISPLAY"
+
+"$XVFB" "$BENCH_DISPLAY" -ac -noreset -nolisten tcp -screen 0 1280x720x24 \
+    2>/dev/null &
+XVFB_PID=$!
+trap 'kill $DAEL_PID $XVFB_PID 2>/dev/null; rm -rf "$RUNTIME"' EXIT
+
+i=0
+while [ ! -e "/tmp/.X11-unix/X${BENCH_DISPLAY#:}" ] && [ $i -lt 50 ]; do
+    sleep 0.1
+    i=$((i + 1))
+done
+
+echo "dael $BENCH_DAEL"
+# windows that are there before dael starts
+./daelbench -a "$BENCH_DAEL" "$@" 2>/dev/null
+"$BENCH_DAEL" 2>/dev/null &
+DAEL_PID=$!
+./daelbench -p $DAEL_PID "$@"
+
+# an idle dael wakes up only for the SIGUSR1 that asks for the stats
+IDLE=${BENCH_IDLE:-5}
+STATS="$RUNTIME/dael/$BENCH_DISPLAY.stats"
+sleep 1
+kill -USR2 $DAEL_PID
+sleep "$IDLE"
+rm -f "$STATS"
+kill -USR1 $DAEL_PID
+i=0
+while [ ! -e "$STATS" ] && [ $i -lt 50 ]; do
+    sleep 0.1
+    i=$((i + 1))
+done
+WAKEUPS=$(sed -n 's/^wakeups //p' "$STATS")
+echo "idle seconds $IDLE wakeups $WAKEUPS"
+if [ "$WAKEUPS" != 1 ]; then
+    echo "bench.sh: dael woke up while idle" >&2
+    exit 1
+fi
@@ -4,6 +4,7 @@
 #define BORDER_SIZE 1
 #define BORDER_FOCUSED 0xff0000
 #define BORDER_UNFOCUSED 0x043764
+#define BORDER_HUNG 0x808080 /* client did not answer a ping */
 
 /*
  * The MODKEY is the modifier key used for keybinds.
@@ -22,6 +23,46 @@
 /* default master window size when on a new workspace */
 #define MASTER_DEFAULT 50
 
+/*
+ * How windows on hidden workspaces are hidden.
+ * 1 = move them off-screen, they stay mapped and do not need to repaint
+ *     everything when their workspace is shown again
+ * 0 = unmap them
+ * make bench builds both to compare them.
+ */
+#ifndef HIDE_OFFSCREEN
+#define HIDE_OFFSCREEN 1
+#endif
+
+/*
+ * Where the runtime statistics are written on SIGUSR1, appended to the
+ * display name in $XDG_RUNTIME_DIR/dael (/tmp/dael-UID without it),
+ * e.g. /run/user/1000/dael/:0.stats
+ */
+#define STATS_FILE ".stats"
+
+/* unix socket that accepts commands, see daelc, next to the STATS_FILE */
+#define CONTROL_SOCKET ".sock"
+
+/*
+ * Windows that show up within this many seconds of a launch_program are
+ * put on the workspace the program was launched from.
+ */
+#define LAUNCH_TIMEOUT 30
+
+/*
+ * Milliseconds a client gets to answer a ping before it is shown as hung,
+ * and to close after each step of kill_window.
+ */
+#define PING_TIMEOUT 2000
+#define KILL_TIMEOUT 3000
+
+/*
+ * While increase_size or decrease_size is held down the layout is redone
+ * at most once per this many milliseconds (about one frame at 60Hz).
+ */
+#define REPEAT_INTERVAL 16
+
 #define MASTER_MAX 90 /* maximum master window size % */
 #define MASTER_MIN 50 /* minimum master window size % */
 
@@ -31,10 +72,12 @@ static const Dael_Keybinding config_keys[] = {
  { MODKEY,             XK_Return,        launch_program,   "st"        },
  { MODKEY | ShiftMask, XK_q,             kill_window                   },
  { MODKEY | ShiftMask, XK_e,             quit                          },
+ { MODKEY | ShiftMask, XK_r,             restart                       },
  { MODKEY | ShiftMask, XK_l,             next_workspace                },
  { MODKEY | ShiftMask, XK_h,             prev_workspace                },
  { MODKEY | ShiftMask, XK_w,             append_workspace              },
  { MODKEY,             XK_m,             cycle_tiling_mode             },
+ { MODKEY,             XK_period,        next_monitor                  },
  { MODKEY,             XK_l,             focus_next                    },
  { MODKEY,             XK_h,             focus_prev                    },
  { MODKEY,             XK_space,         swap_master                   },
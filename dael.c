@@ -5,170 +5,138 @@
  * Date Created: Feb 27, 2025
  * Last Modified: March 05, 2025
  */
-#include <X11/Xlib.h>
-#include <X11/keysym.h>
-#include <X11/Xutil.h>
-#include <X11/Xatom.h>
-#include <stdbool.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <signal.h>
-#include <sys/wait.h>
-#include <unistd.h>
-
-typedef enum {
-        NORMAL,
-        MONOCLE,
-
-        MODE_COUNT /* not a tiling mode, just designates size of enum */
-} Dael_TilingMode;
-
-typedef struct Dael_Client Dael_Client;
-typedef struct Dael_Workspace Dael_Workspace;
-
-struct Dael_Client {
-        Window win;
-        bool is_fullscreen;
-        bool is_floating;
-        Dael_Client* next;
-        Dael_Client* prev;
-};
+#include "dael.h"
+#include "config.h"
 
-struct Dael_Workspace {
-        unsigned int id;
-        unsigned int master_size;
-        Dael_TilingMode mode;
-        Dael_Client* clients;
-        Dael_Client* focused;
-        Dael_Workspace* next;
-        Dael_Workspace* prev;
+/* must be kept in the same order as Dael_Atom */
+static char* atom_names[ATOM_COUNT] = {
+        "WM_PROTOCOLS",
+        "WM_DELETE_WINDOW",
+        "WM_STATE",
+        "_NET_WM_STATE",
+        "_NET_WM_STATE_FULLSCREEN",
+        "_NET_WM_STATE_HIDDEN",
+        "_NET_WM_WINDOW_TYPE",
+        "_NET_WM_WINDOW_TYPE_DIALOG",
+        "_NET_WM_PID",
+        "_NET_STARTUP_ID",
+        "_NET_WM_PING",
+        "_NET_SUPPORTED",
+        "_NET_SUPPORTING_WM_CHECK",
+        "_NET_WM_NAME",
+        "_NET_CLIENT_LIST",
+        "_NET_ACTIVE_WINDOW",
+        "_NET_CURRENT_DESKTOP",
+        "_NET_NUMBER_OF_DESKTOPS",
+        "UTF8_STRING",
+        "_DAEL_STATE"
 };
 
-typedef struct {
-        unsigned int mod;
-        KeySym key_sym;
-        void (*func)(const char*);
-        const void* arg;
-} Dael_Keybinding;
-
-typedef struct {
-        Dael_Workspace* workspaces;
-        Dael_Workspace* current_workspace;
-        Window root;
-        Display* dpy;
-        bool running;
-} Dael_State;
-
-typedef struct {
-        int event_type;
-        void (*handler)(XEvent*);
-} Dael_EventHandler;
-
-/* handy macro from dwm */
-#define CLEANMASK(mask) (mask & ~(numlockmask | LockMask))
-
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
-#define MIN(a, b) ((a) < (b) ? (a) : (b))
-
-/* config.h / user key-bindable functions */
-void launch_program(const char* program);
-void quit(const char* args);
-void swap_master(const char* args);
-void focus_next(const char* args);
-void focus_prev(const char* args);
-void increase_size(const char* args);
-void decrease_size(const char* args);
-void append_workspace(const char* args);
-void next_workspace(const char* args);
-void prev_workspace(const char* args);
-void cycle_tiling_mode(const char* args);
-void kill_window(const char* args);
-
-
-#include "config.h"
-
-void update_numlockmask(void);
-Dael_Client* add_client(Window win);
-void remove_client(Dael_Workspace* ws, Dael_Client* c);
-Dael_Client* get_client(Window win);
-void hide_workspace(Dael_Workspace* ws);
-void show_workspace(Dael_Workspace* ws);
-Dael_Workspace* get_workspace_for_client(Dael_Client* client);
-
-void get_screen_center(int* x, int* y);
-void change_master_size(int amount);
-void apply_layout(void);
-void manage_floating_windows(void);
-void tile_normal(int w, int h);
-void tile_monocle(int w, int h);
-void grab_keys(void);
-int send_event(Dael_Client* c, Atom proto);
-Atom get_window_atom_property(Dael_Client* c, Atom prop);
-void set_window_focus(Dael_Client* client);
-void update_window_type(Dael_Client* c);
-void set_window_border(Dael_Client* client);
-void remove_window_border(Dael_Client* client);
-void handle_event(XEvent* e);
-void handle_property_notify(XEvent* e);
-void handle_configure_request(XEvent *e);
-void handle_key_press(XEvent* e);
-void handle_map_request(XEvent* e);
-void handle_destroy_notify(XEvent* e);
-
-void Dael_State_init(Dael_State* state);
-void Dael_State_free(Dael_State* state);
-
-int xerror_handler(Display* display, XErrorEvent* error);
-int xerror_ignore(Display* display, XErrorEvent* error);
-void die(const char* e);
+/* advertised in _NET_SUPPORTED */
+static const Dael_Atom supported_atoms[] = {
+        ATOM_NET_SUPPORTED,
+        ATOM_NET_SUPPORTING_WM_CHECK,
+        ATOM_NET_CLIENT_LIST,
+        ATOM_NET_ACTIVE_WINDOW,
+        ATOM_NET_CURRENT_DESKTOP,
+        ATOM_NET_NUMBER_OF_DESKTOPS,
+        ATOM_NET_WM_STATE,
+        ATOM_NET_WM_STATE_FULLSCREEN,
+        ATOM_NET_WM_STATE_HIDDEN,
+        ATOM_NET_WM_WINDOW_TYPE,
+        ATOM_NET_WM_WINDOW_TYPE_DIALOG,
+        ATOM_NET_WM_PING
+};
 
 /* XEvent handler functions */
 Dael_EventHandler event_handlers[] = {
     { KeyPress, handle_key_press },
+    { KeyRelease, handle_key_release },
     { MapRequest, handle_map_request },
     { PropertyNotify, handle_property_notify },
     { DestroyNotify, handle_destroy_notify },
+    { UnmapNotify, handle_unmap_notify },
     { ConfigureRequest, handle_configure_request },
+    { MappingNotify, handle_mapping_notify },
+    { ClientMessage, handle_client_message },
     { 0, NULL }
 };
 
-/* global window manager state */
-Dael_State wm = { 0 };
-unsigned int numlockmask;
-
-
-int main(void)
-{
-        struct sigaction sa;
-        XSetErrorHandler(xerror_handler);
-        Dael_State_init(&wm);
-        grab_keys();
-        XFlush(wm.dpy);
-        XSync(wm.dpy, False);
-        wm.running = true;
-
-        update_numlockmask();
+static const Dael_Backend xlib_backend = {
+        xlib_map,
+        xlib_unmap,
+        xlib_move,
+        xlib_move_resize,
+        xlib_configure,
+        xlib_set_border_width,
+        xlib_set_border_color,
+        xlib_raise,
+        xlib_focus,
+        xlib_select_input,
+        xlib_change_property,
+        xlib_delete_property,
+        xlib_get_property,
+        xlib_send_event,
+        xlib_kill_client,
+        xlib_grab,
+        xlib_ungrab,
+        xlib_screen_width,
+        xlib_screen_height,
+        xlib_next_request
+};
 
-        /* zombie handling from dwm */
-        /* do not transform children into zombies */
-        sigemptyset(&sa.sa_mask);
-        sa.sa_flags = SA_NOCLDSTOP | SA_NOCLDWAIT | SA_RESTART;
-        sa.sa_handler = SIG_IGN;
-        sigaction(SIGCHLD, &sa, NULL);
+/* event_handlers indexed by event type, built at startup */
+void (*handler_table[LASTEvent])(XEvent*);
 
-        /* cleanup zombies */
-        while (waitpid(-1, NULL, WNOHANG) > 0);
+/* global window manager state */
+Dael_State wm = { 0 };
+char** dael_argv;
+extern char** environ;
+
+
+/* indexed by event type, for the stats dump */
+static const char* event_names[LASTEvent] = {
+        "Error", "Reply", "KeyPress", "KeyRelease", "ButtonPress",
+        "ButtonRelease", "MotionNotify", "EnterNotify", "LeaveNotify",
+        "FocusIn", "FocusOut", "KeymapNotify", "Expose", "GraphicsExpose",
+        "NoExpose", "VisibilityNotify", "CreateNotify", "DestroyNotify",
+        "UnmapNotify", "MapNotify", "MapRequest", "ReparentNotify",
+        "ConfigureNotify", "ConfigureRequest", "GravityNotify",
+        "ResizeRequest", "CirculateNotify", "CirculateRequest",
+        "PropertyNotify", "SelectionClear", "SelectionRequest",
+        "SelectionNotify", "ColormapNotify", "ClientMessage",
+        "MappingNotify", "GenericEvent"
+};
 
+/* functions that can be run through the control socket */
+static const Dael_Command commands[] = {
+        { "launch_program", launch_program },
+        { "kill_window", kill_window },
+        { "quit", quit },
+        { "restart", restart },
+        { "append_workspace", append_workspace },
+        { "next_workspace", next_workspace },
+        { "prev_workspace", prev_workspace },
+        { "focus_next", focus_next },
+        { "focus_prev", focus_prev },
+        { "swap_master", swap_master },
+        { "increase_size", increase_size },
+        { "decrease_size", decrease_size },
+        { "cycle_tiling_mode", cycle_tiling_mode },
+        { "next_monitor", next_monitor },
+        { "sync", sync_control },
+        { NULL, NULL }
+};
 
-        while (wm.running) {
-                XEvent e;
-                XNextEvent(wm.dpy, &e);
-                handle_event(&e);
-        }
+/* indexed by Dael_TilingMode */
+const char* mode_names[MODE_COUNT] = { "normal", "monocle" };
+unsigned int numlockmask;
 
-        Dael_State_free(&wm);
-        return 0;
-}
+/* index + 1 into key_bindings for each (keycode, cleaned modifier mask),
+ * 0 when nothing is bound */
+unsigned short key_table[KEYCODE_COUNT][KEYMASK_COUNT];
+/* config_keys, unless daeltest times a table of its own */
+const Dael_Keybinding* key_bindings = config_keys;
 
 
 void update_numlockmask(void)
@@ -178,6 +146,8 @@ void update_numlockmask(void)
         unsigned int k;
         int j;
 
+        wm.stats.round_trips++;
+
         numlockmask = 0;
 
         for (k = 0; k < 8; k++) {
@@ -195,23 +165,82 @@ void update_numlockmask(void)
 }
 
 
-Dael_Client* add_client(Window win)
+/* resolve keybindings against the current keyboard mapping, called at
+ * startup and again whenever the mapping changes */
+void setup_keys(void)
 {
-        Dael_Client* new_c = malloc(sizeof(Dael_Client));
-        Dael_Client* last;
+        update_numlockmask();
+        build_key_table();
+        grab_keys();
+}
+
+
+void build_key_table(void)
+{
+        unsigned int i;
 
+        memset(key_table, 0, sizeof(key_table));
+
+        for (i = 0; key_bindings[i].key_sym != NoSymbol; i++) {
+                KeyCode keycode = XKeysymToKeycode(wm.dpy, key_bindings[i].key_sym);
+                unsigned int mod = key_bindings[i].mod;
+
+                if (!keycode || mod >= KEYMASK_COUNT || !key_bindings[i].func)
+                        continue;
+                /* first binding wins, like the old linear scan */
+                if (!key_table[keycode][mod])
+                        key_table[keycode][mod] = i + 1;
+        }
+}
+
+
+Dael_Client* add_client(Window win)
+{
         if (!wm.current_workspace) {
                 append_workspace(NULL);
                 wm.workspaces = wm.current_workspace;
         }
+        return attach_client(wm.current_workspace, win);
+}
+
+
+/* append a new client for win to the end of ws */
+Dael_Client* attach_client(Dael_Workspace* ws, Window win)
+{
+        Dael_Client* new_c = pool_alloc(&wm.client_pool);
+        Dael_Client* last;
+
+        if (!new_c)
+                die("failed to allocate client");
+
         new_c->win = win;
         new_c->is_fullscreen = false;
+        new_c->is_floating = false;
+        new_c->is_hidden = false;
+        new_c->ignore_unmap = 0;
+        new_c->protocols_known = false;
+        new_c->protocols = 0;
+        new_c->is_hung = false;
+        new_c->needs_map = false;
+        new_c->ping_pending = false;
+        new_c->kill_stage = 0;
+        new_c->kill_pending = false;
+        new_c->geom.x = new_c->geom.y = -1;
+        new_c->geom.w = new_c->geom.h = -1;
+        new_c->geom.border_width = -1;
+        new_c->geom.border_color = -1;
+        set_rect(&new_c->float_geom, 0, 0, 0, 0, 0);
+        new_c->ws = ws;
         new_c->next = NULL;
         new_c->prev = NULL;
+        new_c->hnext = NULL;
+        index_insert(new_c);
+        wm.backend->change_property(wm.root, wm.atoms[ATOM_NET_CLIENT_LIST], XA_WINDOW,
+                        32, PropModeAppend, (unsigned char*) &win, 1);
 
-        last = wm.current_workspace->clients;
+        last = ws->clients;
         if (!last) {
-                wm.current_workspace->clients = new_c;
+                ws->clients = new_c;
         }
         else {
                 while (last->next)
@@ -229,6 +258,10 @@ void remove_client(Dael_Workspace* ws, Dael_Client* c)
         if (!ws || !c)
                 return;
 
+        index_remove(c);
+        if (wm.active_win == c->win)
+                update_active_window(None);
+
         if (c->prev)
                 c->prev->next = c->next;
         if (c->next)
@@ -239,35 +272,249 @@ void remove_client(Dael_Workspace* ws, Dael_Client* c)
 
         if (ws->focused == c) {
                 ws->focused = (c->next) ? c->next : c->prev;
-                if (ws->focused)
+                if (ws->focused && ws == wm.current_workspace)
                         set_window_focus(ws->focused);
         }
 
-        free(c);
+        pool_free(&wm.client_pool, c);
+        reclaim_workspaces();
+        update_client_list();
+}
+
+
+/* take c out of the list of ws and put it back in front of before, or at
+ * the end when before is NULL */
+void move_client_before(Dael_Workspace* ws, Dael_Client* c, Dael_Client* before)
+{
+        Dael_Client* last;
+
+        if (c->prev)
+                c->prev->next = c->next;
+        else
+                ws->clients = c->next;
+        if (c->next)
+                c->next->prev = c->prev;
+
+        c->next = before;
+        if (before) {
+                c->prev = before->prev;
+                before->prev = c;
+        }
+        else {
+                for (last = ws->clients; last && last->next; last = last->next)
+                        ;
+                c->prev = last;
+        }
+
+        if (c->prev)
+                c->prev->next = c;
+        else
+                ws->clients = c;
 }
 
 
 Dael_Client* get_client(Window win)
 {
         Dael_Client* c;
-        Dael_Workspace* ws;
-        for (ws = wm.workspaces; ws; ws = ws->next)
-                for (c = ws->clients; c; c = c->next)
-                        if (c->win == win)
-                                return c;
-        return NULL;
+
+        if (!wm.index.buckets)
+                return NULL;
+
+        c = wm.index.buckets[index_hash(win, wm.index.size)];
+        while (c && c->win != win)
+                c = c->hnext;
+        return c;
 }
 
 
-void append_workspace(const char* args)
+unsigned long index_hash(Window win, unsigned long size)
+{
+        /* XIDs of one client share their high bits and count up from
+         * the bottom, so mix the bits before masking */
+        unsigned long h = (unsigned long) win;
+        h ^= h >> 16;
+        h *= 0x45d9f3bUL;
+        h ^= h >> 16;
+        return h & (size - 1);
+}
+
+
+void index_insert(Dael_Client* c)
+{
+        unsigned long i;
+
+        if (wm.index.count >= wm.index.size)
+                index_grow();
+
+        i = index_hash(c->win, wm.index.size);
+        c->hnext = wm.index.buckets[i];
+        wm.index.buckets[i] = c;
+        wm.index.count++;
+}
+
+
+void index_remove(Dael_Client* c)
+{
+        Dael_Client** p;
+
+        if (!wm.index.buckets)
+                return;
+
+        p = &wm.index.buckets[index_hash(c->win, wm.index.size)];
+        while (*p) {
+                if (*p == c) {
+                        *p = c->hnext;
+                        c->hnext = NULL;
+                        wm.index.count--;
+                        return;
+                }
+                p = &(*p)->hnext;
+        }
+}
+
+
+/* double the bucket count (keeps the load factor at or below 1) */
+void index_grow(void)
+{
+        unsigned long new_size;
+        unsigned long i;
+        Dael_Client** buckets;
+
+        new_size = (wm.index.size) ? wm.index.size * 2 : INDEX_INITIAL_SIZE;
+        buckets = calloc(new_size, sizeof(Dael_Client*));
+        if (!buckets)
+                die("failed to allocate client index");
+
+        for (i = 0; i < wm.index.size; i++) {
+                Dael_Client* c = wm.index.buckets[i];
+                while (c) {
+                        Dael_Client* next = c->hnext;
+                        unsigned long j = index_hash(c->win, new_size);
+                        c->hnext = buckets[j];
+                        buckets[j] = c;
+                        c = next;
+                }
+        }
+
+        free(wm.index.buckets);
+        wm.index.buckets = buckets;
+        wm.index.size = new_size;
+}
+
+
+Dael_Workspace* alloc_workspace(unsigned int id)
 {
-        Dael_Workspace* new_ws = malloc(sizeof(Dael_Workspace));
-        new_ws->id = (wm.current_workspace) ? wm.current_workspace->id + 1 : 1;
+        Dael_Workspace* new_ws = pool_alloc(&wm.workspace_pool);
+
+        new_ws->id = id;
+        wm.last_workspace_id = MAX(wm.last_workspace_id, id);
         new_ws->clients = NULL;
+        new_ws->focused = NULL;
         new_ws->next = NULL;
         new_ws->prev = NULL;
         new_ws->mode = NORMAL;
+        new_ws->monitor = -1;
+        new_ws->needs_layout = false;
         new_ws->master_size = MASTER_DEFAULT;
+        return new_ws;
+}
+
+
+/* drop empty workspaces from the end of the list, shown ones, the first
+ * one and ones a pending launch will put its window on are always kept */
+void reclaim_workspaces(void)
+{
+        Dael_Workspace* last = wm.current_workspace;
+
+        if (!last)
+                return;
+        while (last->next)
+                last = last->next;
+
+        expire_launches();
+        while (last != wm.current_workspace && last != wm.workspaces
+        && !last->clients && last->monitor < 0 && !launch_pending(last->id)) {
+                Dael_Workspace* prev = last->prev;
+                prev->next = NULL;
+                pool_free(&wm.workspace_pool, last);
+                last = prev;
+        }
+}
+
+
+void pool_init(Dael_Pool* pool, size_t item_size, size_t per_slab)
+{
+        /* every item has to be able to hold the free list link */
+        item_size = MAX(item_size, sizeof(void*));
+        pool->item_size = (item_size + sizeof(Dael_Slab) - 1)
+                        / sizeof(Dael_Slab) * sizeof(Dael_Slab);
+        pool->per_slab = per_slab;
+        pool->free_list = NULL;
+        pool->slabs = NULL;
+        pool->slab_count = 0;
+        pool->in_use = 0;
+        pool->allocs = 0;
+}
+
+
+void* pool_alloc(Dael_Pool* pool)
+{
+        void* item;
+
+        if (!pool->free_list) {
+                Dael_Slab* slab = malloc(sizeof(Dael_Slab) + pool->item_size * pool->per_slab);
+                char* p;
+                size_t i;
+
+                if (!slab)
+                        die("out of memory");
+
+                slab->next = pool->slabs;
+                pool->slabs = slab;
+                pool->slab_count++;
+
+                /* thread the new items onto the free list in address order
+                 * so neighbouring allocations stay adjacent */
+                p = (char*) (slab + 1);
+                for (i = pool->per_slab; i > 0; i--) {
+                        void* it = p + (i - 1) * pool->item_size;
+                        *(void**) it = pool->free_list;
+                        pool->free_list = it;
+                }
+        }
+
+        item = pool->free_list;
+        pool->free_list = *(void**) item;
+        pool->in_use++;
+        pool->allocs++;
+        return item;
+}
+
+
+void pool_free(Dael_Pool* pool, void* item)
+{
+        *(void**) item = pool->free_list;
+        pool->free_list = item;
+        pool->in_use--;
+}
+
+
+void pool_destroy(Dael_Pool* pool)
+{
+        while (pool->slabs) {
+                Dael_Slab* next = pool->slabs->next;
+                free(pool->slabs);
+                pool->slabs = next;
+        }
+        pool->free_list = NULL;
+        pool->slab_count = 0;
+        pool->in_use = 0;
+}
+
+
+void append_workspace(const char* args)
+{
+        Dael_Workspace* new_ws = alloc_workspace(wm.last_workspace_id + 1);
 
         (void) args;
 
@@ -289,47 +536,93 @@ void append_workspace(const char* args)
 void next_workspace(const char* args)
 {
         (void) args;
-        if (wm.current_workspace && wm.current_workspace->next) {
-                hide_workspace(wm.current_workspace);
-                wm.current_workspace = wm.current_workspace->next;
-                show_workspace(wm.current_workspace);
-        }
+        if (wm.current_workspace && wm.current_workspace->next)
+                switch_workspace(wm.current_workspace->next);
 }
 
 
 void prev_workspace(const char* args)
 {
         (void) args;
-        if (wm.current_workspace && wm.current_workspace->prev) {
-                hide_workspace(wm.current_workspace);
-                wm.current_workspace = wm.current_workspace->prev;
-                show_workspace(wm.current_workspace);
+        if (wm.current_workspace && wm.current_workspace->prev)
+                switch_workspace(wm.current_workspace->prev);
+}
+
+
+/*
+ * Show ws on the selected output. A workspace that is already shown on
+ * another output trades places with the current one. The server is
+ * grabbed so the old and new workspace never show up half swapped.
+ */
+void switch_workspace(Dael_Workspace* ws)
+{
+        Dael_Workspace* old = wm.current_workspace;
+
+        wm.backend->grab();
+        if (ws->monitor >= 0) {
+                show_on_monitor(old, ws->monitor);
+        }
+        else {
+                hide_workspace(old);
+                old->monitor = -1;
         }
+        show_on_monitor(ws, wm.selected_monitor);
+        wm.current_workspace = ws;
+        reclaim_workspaces();
+
+        if (ws->focused)
+                set_window_focus(ws->focused);
+        else
+                focus_root();
+        wm.backend->ungrab();
 }
 
 
 void cycle_tiling_mode(const char* args)
 {
-        Dael_TilingMode cur = wm.current_workspace->mode;
+        Dael_TilingMode cur;
         (void) args;
 
+        if (!wm.current_workspace)
+                return;
+
+        cur = wm.current_workspace->mode;
         wm.current_workspace->mode = (cur + 1) % MODE_COUNT;
-        apply_layout();
+        request_layout(wm.current_workspace);
 }
 
 
+/*
+ * With HIDE_OFFSCREEN the windows stay mapped and are only moved out of
+ * sight, which spares every client an unmap, remap and full repaint.
+ * Either way they are marked iconic so clients can stop rendering.
+ */
 void hide_workspace(Dael_Workspace* ws)
 {
         Dael_Client* client;
+        int screen_w = wm.backend->screen_width();
         if (!ws)
                 return;
         client = ws->clients;
         while (client) {
-                XUnmapWindow(wm.dpy, client->win);
+                if (HIDE_OFFSCREEN) {
+                        /* keep the cache in sync so the next layout moves
+                         * the window back */
+                        client->geom.x = -2 * screen_w;
+                        wm.backend->move(client->win, client->geom.x,
+                                    MAX(client->geom.y, 0));
+                }
+                else if (!client->needs_map) {
+                        client->ignore_unmap++;
+                        wm.backend->unmap(client->win);
+                }
+                client->is_hidden = true;
+                set_client_state(client, IconicState);
                 client = client->next;
         }
 }
 
+
 void show_workspace(Dael_Workspace* ws)
 {
         Dael_Client* client;
@@ -337,27 +630,191 @@ void show_workspace(Dael_Workspace* ws)
                 return;
         client = ws->clients;
         while (client) {
-                XMapWindow(wm.dpy, client->win);
+                client->is_hidden = false;
+                set_client_state(client, NormalState);
+                /* new windows are left to apply_layout */
+                if (!HIDE_OFFSCREEN && !client->needs_map)
+                        wm.backend->map(client->win);
                 client = client->next;
         }
+        /* lay out right away so this still happens under the grab, but
+         * a control block only gets its one layout at the end */
+        if (wm.in_block)
+                request_layout(ws);
+        else
+                apply_layout(ws);
 }
 
 
-Dael_Workspace* get_workspace_for_client(Dael_Client* client)
+void show_on_monitor(Dael_Workspace* ws, int m)
 {
-        Dael_Workspace* ws = wm.workspaces;
+        wm.monitors[m].ws = ws;
+        ws->monitor = m;
+        show_workspace(ws);
+}
 
-        while (ws) {
-                Dael_Client* c = ws->clients;
-                while (c) {
-                        if (c == client) {
-                                return ws;
-                        }
-                        c = c->next;
+
+void next_monitor(const char* args)
+{
+        Dael_Workspace* ws;
+        (void) args;
+
+        if (wm.monitor_count < 2)
+                return;
+
+        /* redraw the borders on both sides */
+        request_layout(wm.current_workspace);
+        wm.selected_monitor = (wm.selected_monitor + 1) % wm.monitor_count;
+        ws = wm.current_workspace = wm.monitors[wm.selected_monitor].ws;
+        request_layout(ws);
+
+        if (ws->focused)
+                set_window_focus(ws->focused);
+        else
+                focus_root();
+}
+
+
+/*
+ * Re-read the output geometry and make sure every output shows a
+ * workspace. Workspaces keep their output as long as it exists, those
+ * whose output went away are hidden.
+ */
+void update_monitors(void)
+{
+        Dael_Rect rects[MAX_MONITORS];
+        int n = query_outputs(rects, MAX_MONITORS);
+        Dael_Workspace* ws;
+        int i;
+
+        for (i = 0; i < n; i++) {
+                wm.monitors[i].geom = rects[i];
+                wm.monitors[i].ws = NULL;
+        }
+        wm.monitor_count = n;
+
+        for (ws = wm.workspaces; ws; ws = ws->next) {
+                if (ws->monitor < 0)
+                        continue;
+                if (ws->monitor < n && !wm.monitors[ws->monitor].ws) {
+                        wm.monitors[ws->monitor].ws = ws;
+                        request_layout(ws);
+                }
+                else {
+                        hide_workspace(ws);
+                        ws->monitor = -1;
                 }
-                ws = ws->next;
         }
-        return NULL;
+
+        if (wm.selected_monitor >= n)
+                wm.selected_monitor = 0;
+        if (wm.current_workspace && wm.current_workspace->monitor < 0
+        && !wm.monitors[wm.selected_monitor].ws)
+                show_on_monitor(wm.current_workspace, wm.selected_monitor);
+
+        for (i = 0; i < n; i++)
+                if (!wm.monitors[i].ws)
+                        show_on_monitor(unused_workspace(), i);
+
+        wm.current_workspace = wm.monitors[wm.selected_monitor].ws;
+}
+
+
+/* the output rectangles, or the whole screen without RandR */
+int query_outputs(Dael_Rect* out, int max)
+{
+        int n = 0;
+#ifdef XRANDR
+        XRRMonitorInfo* info;
+        int count;
+        int i;
+
+        if (wm.screen_change_event >= 0
+        && (info = XRRGetMonitors(wm.dpy, wm.root, True, &count))) {
+                wm.stats.round_trips++;
+                for (i = 0; i < count && n < max; i++)
+                        set_rect(&out[n++], info[i].x, info[i].y,
+                                 info[i].width, info[i].height, 0);
+                XRRFreeMonitors(info);
+        }
+#else
+        (void) max;
+#endif
+        if (!n)
+                set_rect(&out[n++], 0, 0,
+                         wm.backend->screen_width(), wm.backend->screen_height(), 0);
+        return n;
+}
+
+
+/* first hidden workspace, or a new one at the end of the list */
+Dael_Workspace* unused_workspace(void)
+{
+        Dael_Workspace* ws;
+        Dael_Workspace* last = NULL;
+
+        for (ws = wm.workspaces; ws; ws = ws->next) {
+                if (ws->monitor < 0)
+                        return ws;
+                last = ws;
+        }
+
+        ws = alloc_workspace(wm.last_workspace_id + 1);
+        if (last) {
+                last->next = ws;
+                ws->prev = last;
+        }
+        else {
+                wm.workspaces = ws;
+        }
+        return ws;
+}
+
+
+void handle_screen_change(XEvent* e)
+{
+#ifdef XRANDR
+        XRRUpdateConfiguration(e);
+#else
+        (void) e;
+#endif
+        update_monitors();
+}
+
+
+/* sets the ICCCM WM_STATE and the matching _NET_WM_STATE of a client */
+void set_client_state(Dael_Client* c, long state)
+{
+        long data[2];
+        Atom net_state[2];
+        int n = 0;
+
+        data[0] = state;
+        data[1] = None;
+        wm.backend->change_property(c->win, wm.atoms[ATOM_WM_STATE],
+                        wm.atoms[ATOM_WM_STATE], 32, PropModeReplace,
+                        (unsigned char*) data, 2);
+
+        if (c->is_fullscreen)
+                net_state[n++] = wm.atoms[ATOM_NET_WM_STATE_FULLSCREEN];
+        if (c->is_hidden)
+                net_state[n++] = wm.atoms[ATOM_NET_WM_STATE_HIDDEN];
+        wm.backend->change_property(c->win, wm.atoms[ATOM_NET_WM_STATE], XA_ATOM,
+                        32, PropModeReplace, (unsigned char*) net_state, n);
+}
+
+
+Dael_Workspace* get_workspace_for_client(Dael_Client* client)
+{
+        return (client) ? client->ws : NULL;
+}
+
+
+Dael_Workspace* find_workspace(unsigned int id)
+{
+        Dael_Workspace* ws;
+        for (ws = wm.workspaces; ws && ws->id != id; ws = ws->next);
+        return ws;
 }
 
 
@@ -367,7 +824,32 @@ void Dael_State_init(Dael_State* state)
                 fprintf(stderr, "Failed to open display.\n");
                 exit(1);
         }
+        state->backend = &xlib_backend;
         state->root = DefaultRootWindow(state->dpy);
+        /* neither launched programs nor the image a restart execs may
+         * inherit the connection, a second dael could not select
+         * SubstructureRedirect while the old one is still open */
+        fcntl(ConnectionNumber(state->dpy), F_SETFD, FD_CLOEXEC);
+        init_state(state);
+
+        /* resolve every atom in a single round trip */
+        if (!XInternAtoms(state->dpy, atom_names, ATOM_COUNT, False, state->atoms))
+                die("failed to intern atoms");
+
+        /* report a held key as presses followed by one release instead of
+         * press/release pairs, servers without XKB keep the old behaviour
+         * and their repeats are simply not throttled */
+        XkbSetDetectableAutoRepeat(state->dpy, True, NULL);
+#ifdef XRANDR
+        {
+                int event_base;
+                int error_base;
+                if (XRRQueryExtension(state->dpy, &event_base, &error_base)) {
+                        state->screen_change_event = event_base + RRScreenChangeNotify;
+                        XRRSelectInput(state->dpy, state->root, RRScreenChangeNotifyMask);
+                }
+        }
+#endif
 
         XSelectInput(
                 state->dpy, state->root,
@@ -379,504 +861,2948 @@ void Dael_State_init(Dael_State* state)
 }
 
 
+/* the part of the state that does not depend on the server */
+void init_state(Dael_State* state)
+{
+        state->index.buckets = NULL;
+        state->index.size = 0;
+        state->index.count = 0;
+        index_grow();
+        pool_init(&state->client_pool, sizeof(Dael_Client), CLIENTS_PER_SLAB);
+        pool_init(&state->workspace_pool, sizeof(Dael_Workspace), WORKSPACES_PER_SLAB);
+
+        state->held_key = 0;
+        state->layout_throttled = false;
+        state->layout_timer = -1;
+        state->client_timer = -1;
+        state->timer_fd = -1;
+        state->signal_fd = -1;
+
+        state->monitor_count = 0;
+        state->selected_monitor = 0;
+        state->screen_change_event = -1;
+        state->control_fd = -1;
+        state->in_block = false;
+}
+
+
 void Dael_State_free(Dael_State* state)
 {
+        /* every client and workspace lives in the pools */
+        state->workspaces = NULL;
+        state->current_workspace = NULL;
+        pool_destroy(&state->client_pool);
+        pool_destroy(&state->workspace_pool);
+
+        free(state->index.buckets);
+        state->index.buckets = NULL;
+        free(state->layout.clients);
+        free(state->layout.flags);
+        free(state->layout.rects);
+        memset(&state->layout, 0, sizeof(state->layout));
+        if (state->timer_fd >= 0)
+                close(state->timer_fd);
+        if (state->signal_fd >= 0)
+                close(state->signal_fd);
+        if (!state->dpy)
+                return;
+        XDestroyWindow(state->dpy, state->check_win);
         XCloseDisplay(state->dpy);
 }
 
 
-void grab_keys(void)
+void xlib_map(Window win)
 {
-        unsigned int i = 0;
-        XUngrabKey(wm.dpy, AnyKey, AnyModifier, wm.root);
+        XMapWindow(wm.dpy, win);
+}
 
-        while (config_keys[i].key_sym != NoSymbol) {
-                KeySym key_sym = config_keys[i].key_sym;
-                KeyCode keycode = XKeysymToKeycode(wm.dpy, key_sym);
-                unsigned int mod = config_keys[i].mod;
 
-                XGrabKey(wm.dpy, keycode, mod, wm.root, True,  GrabModeAsync, GrabModeAsync);
-                i++;
-        }
+void xlib_unmap(Window win)
+{
+        XUnmapWindow(wm.dpy, win);
 }
 
 
-void set_window_border(Dael_Client* client)
+void xlib_move(Window win, int x, int y)
 {
-        unsigned long color;
-        if (!client || !wm.current_workspace)
-                return;
-        color = (wm.current_workspace->focused == client)
-                ? BORDER_FOCUSED : BORDER_UNFOCUSED;
-        XSetWindowBorderWidth(wm.dpy, client->win, BORDER_SIZE);
-        XSetWindowBorder(wm.dpy, client->win, color);
+        XMoveWindow(wm.dpy, win, x, y);
 }
 
 
-void remove_window_border(Dael_Client* client)
+void xlib_move_resize(Window win, int x, int y, unsigned int w, unsigned int h)
 {
-        if (!client)
-                return;
-        XSetWindowBorderWidth(wm.dpy, client->win, 0);
-        XFlush(wm.dpy);
+        XMoveResizeWindow(wm.dpy, win, x, y, w, h);
 }
 
 
-void apply_layout(void)
+void xlib_configure(Window win, unsigned int mask, XWindowChanges* wc)
 {
-        int screen_w = DisplayWidth(wm.dpy, DefaultScreen(wm.dpy));
-        int screen_h = DisplayHeight(wm.dpy, DefaultScreen(wm.dpy));
-
-        if (!wm.current_workspace || !wm.current_workspace->clients)
-                return;
+        XConfigureWindow(wm.dpy, win, mask, wc);
+}
 
-        switch (wm.current_workspace->mode) {
-        case NORMAL:
-                tile_normal(screen_w, screen_h);
-                break;
-        case MONOCLE:
-                tile_monocle(screen_w, screen_h);
-                break;
-        default:
-                tile_normal(screen_w, screen_h);
-        }
 
-        manage_floating_windows();
+void xlib_set_border_width(Window win, unsigned int width)
+{
+        XSetWindowBorderWidth(wm.dpy, win, width);
 }
 
-/* for dialog windows */
-void manage_floating_windows(void)
-{
-        Dael_Client* client = wm.current_workspace->clients;
-        while (client) {
-                int x;
-                int y;
-                unsigned int w = 640;
-                unsigned int h = 480;
 
-                if (!client->is_floating) {
-                        client = client->next;
+void xlib_set_border_color(Window win, unsigned long color)
+{
+        XSetWindowBorder(wm.dpy, win, color);
+}
+
+
+void xlib_raise(Window win)
+{
+        XRaiseWindow(wm.dpy, win);
+}
+
+
+void xlib_focus(Window win)
+{
+        XSetInputFocus(wm.dpy, win, RevertToPointerRoot, CurrentTime);
+}
+
+
+void xlib_select_input(Window win, long mask)
+{
+        XSelectInput(wm.dpy, win, mask);
+}
+
+
+void xlib_change_property(Window win, Atom prop, Atom type, int format, int mode,
+                          const unsigned char* data, int n)
+{
+        XChangeProperty(wm.dpy, win, prop, type, format, mode, data, n);
+}
+
+
+void xlib_delete_property(Window win, Atom prop)
+{
+        XDeleteProperty(wm.dpy, win, prop);
+}
+
+
+int xlib_get_property(Window win, Atom prop, long offset, long length, Bool del,
+                      Atom req_type, Atom* type, int* format, unsigned long* n,
+                      unsigned long* remaining, unsigned char** data)
+{
+        return XGetWindowProperty(wm.dpy, win, prop, offset, length, del, req_type,
+                                  type, format, n, remaining, data);
+}
+
+
+void xlib_send_event(Window win, long mask, XEvent* e)
+{
+        XSendEvent(wm.dpy, win, False, mask, e);
+}
+
+
+void xlib_kill_client(Window win)
+{
+        XKillClient(wm.dpy, win);
+}
+
+
+void xlib_grab(void)
+{
+        XGrabServer(wm.dpy);
+}
+
+
+void xlib_ungrab(void)
+{
+        XUngrabServer(wm.dpy);
+}
+
+
+int xlib_screen_width(void)
+{
+        return DisplayWidth(wm.dpy, DefaultScreen(wm.dpy));
+}
+
+
+int xlib_screen_height(void)
+{
+        return DisplayHeight(wm.dpy, DefaultScreen(wm.dpy));
+}
+
+
+unsigned long xlib_next_request(void)
+{
+        return NextRequest(wm.dpy);
+}
+
+
+void grab_keys(void)
+{
+        unsigned int i = 0;
+        unsigned int j;
+        /* also grab with the lock modifiers so bindings keep working with
+         * numlock or capslock on */
+        unsigned int lockmods[4];
+        lockmods[0] = 0;
+        lockmods[1] = LockMask;
+        lockmods[2] = numlockmask;
+        lockmods[3] = numlockmask | LockMask;
+
+        XUngrabKey(wm.dpy, AnyKey, AnyModifier, wm.root);
+
+        while (key_bindings[i].key_sym != NoSymbol) {
+                KeySym key_sym = key_bindings[i].key_sym;
+                KeyCode keycode = XKeysymToKeycode(wm.dpy, key_sym);
+                unsigned int mod = key_bindings[i].mod;
+
+                if (keycode) {
+                        for (j = 0; j < sizeof(lockmods) / sizeof(lockmods[0]); j++)
+                                XGrabKey(wm.dpy, keycode, mod | lockmods[j], wm.root,
+                                         True, GrabModeAsync, GrabModeAsync);
+                }
+                i++;
+        }
+}
+
+
+void set_window_border(Dael_Client* client)
+{
+        long color;
+        if (!client || !wm.current_workspace)
+                return;
+        if (client->is_hung)
+                color = BORDER_HUNG;
+        else
+                color = (wm.current_workspace->focused == client)
+                        ? BORDER_FOCUSED : BORDER_UNFOCUSED;
+        set_border_width(client, BORDER_SIZE);
+        if (client->geom.border_color != color) {
+                wm.backend->set_border_color(client->win, color);
+                client->geom.border_color = color;
+        }
+}
+
+
+void remove_window_border(Dael_Client* client)
+{
+        if (!client)
+                return;
+        set_border_width(client, 0);
+}
+
+
+void set_border_width(Dael_Client* c, int width)
+{
+        if (c->geom.border_width == width) {
+                wm.stats.configures_skipped++;
+                return;
+        }
+        wm.backend->set_border_width(c->win, width);
+        c->geom.border_width = width;
+        wm.stats.configures_sent++;
+}
+
+
+/* only talks to the server when the geometry actually changed */
+void move_resize_client(Dael_Client* c, int x, int y, int w, int h)
+{
+        Dael_Geometry* g = &c->geom;
+
+        if (g->x == x && g->y == y && g->w == w && g->h == h) {
+                wm.stats.configures_skipped++;
+                return;
+        }
+        wm.backend->move_resize(c->win, x, y, w, h);
+        g->x = x;
+        g->y = y;
+        g->w = w;
+        g->h = h;
+        wm.stats.configures_sent++;
+}
+
+
+/* layouts are deferred to the end of the current event batch */
+void request_layout(Dael_Workspace* ws)
+{
+        if (ws)
+                ws->needs_layout = true;
+}
+
+
+/* only the outputs whose workspace changed are laid out */
+void apply_pending_layout(void)
+{
+        int delay = layout_delay();
+        int i;
+
+        if (delay > 0) {
+                if (wm.layout_timer < 0)
+                        wm.layout_timer = add_timer(delay, layout_timeout, NULL);
+                return;
+        }
+
+        for (i = 0; i < wm.monitor_count; i++)
+                if (wm.monitors[i].ws && wm.monitors[i].ws->needs_layout)
+                        apply_layout(wm.monitors[i].ws);
+}
+
+
+/*
+ * Milliseconds until the pending layouts may run, -1 if there are none.
+ * While a resize binding autorepeats the layouts are held back to one per
+ * REPEAT_INTERVAL, the size changes of the repeats in between add up in
+ * master_size and the key release lets the final one through at once.
+ */
+int layout_delay(void)
+{
+        struct timespec now;
+        long elapsed;
+        int i;
+
+        for (i = 0; i < wm.monitor_count; i++)
+                if (wm.monitors[i].ws && wm.monitors[i].ws->needs_layout)
+                        break;
+        if (i == wm.monitor_count)
+                return -1;
+        if (!wm.layout_throttled)
+                return 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (now.tv_sec - wm.last_layout.tv_sec) * 1000L
+                + (now.tv_nsec - wm.last_layout.tv_nsec) / 1000000L;
+        return (elapsed >= REPEAT_INTERVAL) ? 0 : (int) (REPEAT_INTERVAL - elapsed);
+}
+
+
+/* only wakes the loop up, which then lays out */
+void layout_timeout(void* arg)
+{
+        (void) arg;
+        wm.layout_timer = -1;
+}
+
+
+/* hidden workspaces keep their needs_layout until they are shown */
+void apply_layout(Dael_Workspace* ws)
+{
+        const Dael_Rect* mon;
+        struct timespec start;
+        unsigned long first_request;
+        Dael_LayoutBuffer* buf = &wm.layout;
+        Dael_Client* c;
+        size_t n = 0;
+        size_t i;
+
+        if (!ws || ws->monitor < 0)
+                return;
+        mon = &wm.monitors[ws->monitor].geom;
+
+        ws->needs_layout = false;
+
+        if (!ws->clients)
+                return;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        first_request = wm.backend->next_request();
+        wm.last_layout = start;
+
+        for (c = ws->clients; c; c = c->next) {
+                if (n == buf->capacity)
+                        grow_layout_buffer(buf);
+                buf->clients[n] = c;
+                buf->flags[n] = is_tiled(c) ? 0 : LAYOUT_FLOATING;
+                n++;
+        }
+
+        switch (ws->mode) {
+        case MONOCLE:
+                layout_monocle(buf->flags, n, mon->w, mon->h, buf->rects);
+                break;
+        case NORMAL:
+        default:
+                layout_normal(buf->flags, n, mon->w, mon->h,
+                              ws->master_size, buf->rects);
+        }
+
+        for (i = 0; i < n; i++) {
+                const Dael_Rect* r = &buf->rects[i];
+                c = buf->clients[i];
+
+                if (r->border_width && !c->is_fullscreen)
+                        set_window_border(c);
+                else
+                        remove_window_border(c);
+                /* fullscreen clients are left out of the tiling and cover
+                 * their output */
+                if (c->is_fullscreen)
+                        move_resize_client(c, mon->x, mon->y, mon->w, mon->h);
+                else if (c->is_floating && c->float_geom.w > 0)
+                        move_resize_client(c, c->float_geom.x, c->float_geom.y,
+                                           c->float_geom.w, c->float_geom.h);
+                else
+                        move_resize_client(c, mon->x + r->x, mon->y + r->y, r->w, r->h);
+        }
+
+        /* new windows go after all the configures, so neither they nor
+         * their neighbours are drawn at a size they are about to lose */
+        for (i = 0; i < n; i++) {
+                c = buf->clients[i];
+                if (!c->needs_map)
+                        continue;
+                c->needs_map = false;
+                wm.backend->map(c->win);
+                if (ws == wm.current_workspace && ws->focused == c)
+                        set_window_focus(c);
+        }
+
+        record_timing(&wm.stats.layouts[ws->mode % MODE_COUNT], &start, first_request);
+}
+
+
+/* adopted from dwm.c from suckless */
+int send_event(Dael_Client* c, Dael_Atom proto)
+{
+        int exists;
+        XEvent e;
+
+        if (!c->protocols_known)
+                update_protocols(c);
+
+        exists = (c->protocols >> proto) & 1;
+        if (exists) {
+                e.type = ClientMessage;
+                e.xclient.window = c->win;
+                e.xclient.message_type = wm.atoms[ATOM_WM_PROTOCOLS];
+                e.xclient.format = 32;
+                e.xclient.data.l[0] = wm.atoms[proto];
+		e.xclient.data.l[1] = CurrentTime;
+                /* only _NET_WM_PING looks at these, it wants the window
+                 * back in its reply */
+                e.xclient.data.l[2] = c->win;
+                e.xclient.data.l[3] = 0;
+                e.xclient.data.l[4] = 0;
+                wm.backend->send_event(c->win, NoEventMask, &e);
+        }
+        return exists;
+}
+
+
+/* WM_PROTOCOLS is read on first use and cached until the client changes
+ * it, so closing a window normally costs no round trip */
+void update_protocols(Dael_Client* c)
+{
+        Atom type;
+        int format;
+        unsigned long n;
+        unsigned long remaining;
+        unsigned char* p = NULL;
+
+        c->protocols = 0;
+        c->protocols_known = true;
+        wm.stats.round_trips++;
+
+        if (wm.backend->get_property(c->win, wm.atoms[ATOM_WM_PROTOCOLS], 0L, 32L,
+                False, XA_ATOM, &type, &format, &n, &remaining, &p) != Success || !p)
+                return;
+
+        if (format == 32)
+                c->protocols = protocol_mask((Atom*) p, n);
+        XFree(p);
+}
+
+
+unsigned long protocol_mask(const Atom* protocols, int n)
+{
+        unsigned long mask = 0;
+        int i;
+
+        while (n-- > 0)
+                for (i = 0; i < ATOM_COUNT; i++)
+                        if (protocols[n] == wm.atoms[i])
+                                mask |= 1UL << i;
+        return mask;
+}
+
+
+/*
+ * Manage every window that was already mapped before dael started.
+ * Xlib only allows one outstanding reply at a time, so the per window
+ * queries go out over a short-lived xcb connection: all requests are
+ * written first and the replies collected afterwards, which costs one
+ * round trip in total instead of several per window.
+ */
+void adopt_existing_windows(void)
+{
+        Window root_ret;
+        Window parent_ret;
+        Window* children = NULL;
+        unsigned int n = 0;
+        xcb_connection_t* conn;
+
+        if (!XQueryTree(wm.dpy, wm.root, &root_ret, &parent_ret, &children, &n) || !n) {
+                if (children)
+                        XFree(children);
+                return;
+        }
+
+        conn = xcb_connect(NULL, NULL);
+        if (xcb_connection_has_error(conn))
+                fprintf(stderr, "dael: cannot query existing windows\n");
+        else
+                adopt_windows(conn, children, n);
+
+        xcb_disconnect(conn);
+        XFree(children);
+}
+
+
+void adopt_windows(xcb_connection_t* conn, const Window* wins, unsigned int n)
+{
+        struct {
+                xcb_get_window_attributes_cookie_t attr;
+                xcb_get_property_cookie_t type;
+                xcb_get_property_cookie_t proto;
+        }* ck = malloc(n * sizeof(*ck));
+        Dael_Client* last = NULL;
+        unsigned int i;
+
+        if (!ck)
+                die("failed to allocate startup queries");
+
+        for (i = 0; i < n; i++) {
+                ck[i].attr = xcb_get_window_attributes(conn, wins[i]);
+                ck[i].type = xcb_get_property(
+                        conn, 0, wins[i], wm.atoms[ATOM_NET_WM_WINDOW_TYPE],
+                        XCB_ATOM_ATOM, 0, 1);
+                ck[i].proto = xcb_get_property(
+                        conn, 0, wins[i], wm.atoms[ATOM_WM_PROTOCOLS],
+                        XCB_ATOM_ATOM, 0, 32);
+        }
+        xcb_flush(conn);
+
+        for (i = 0; i < n; i++) {
+                xcb_get_window_attributes_reply_t* attr;
+                xcb_get_property_reply_t* type;
+                xcb_get_property_reply_t* proto;
+
+                attr = xcb_get_window_attributes_reply(conn, ck[i].attr, NULL);
+                type = xcb_get_property_reply(conn, ck[i].type, NULL);
+                proto = xcb_get_property_reply(conn, ck[i].proto, NULL);
+
+                if (attr && !attr->override_redirect
+                && attr->map_state == XCB_MAP_STATE_VIEWABLE
+                && !get_client(wins[i])) {
+                        Dael_Client* c = add_client(wins[i]);
+
+                        if (type && xcb_get_property_value_length(type) >= 4) {
+                                xcb_atom_t t = *(xcb_atom_t*) xcb_get_property_value(type);
+                                c->is_floating = (t == wm.atoms[ATOM_NET_WM_WINDOW_TYPE_DIALOG]);
+                                if (c->is_floating)
+                                        wm.backend->raise(c->win);
+                        }
+                        if (proto) {
+                                int len = xcb_get_property_value_length(proto) / 4;
+                                xcb_atom_t* p = xcb_get_property_value(proto);
+                                int j;
+
+                                for (j = 0; j < len; j++) {
+                                        Atom a = p[j];
+                                        c->protocols |= protocol_mask(&a, 1);
+                                }
+                                c->protocols_known = true;
+                        }
+                        wm.backend->select_input(c->win, PropertyChangeMask);
+                        set_client_state(c, NormalState);
+                        last = c;
+                }
+
+                free(attr);
+                free(type);
+                free(proto);
+        }
+        free(ck);
+
+        if (last) {
+                wm.current_workspace->focused = last;
+                set_window_focus(last);
+                request_layout(wm.current_workspace);
+        }
+}
+
+
+Atom get_window_atom_property(Dael_Client* c, Atom prop)
+{
+        int dummy_i;
+        unsigned long dummy_l;
+        unsigned char* p = NULL;
+        Atom dummy_a;
+        Atom atom = None;
+
+        wm.stats.round_trips++;
+        if (wm.backend->get_property(c->win, prop, 0L, sizeof atom, False, XA_ATOM,
+                &dummy_a, &dummy_i, &dummy_l, &dummy_l, &p) == Success && p) {
+                atom = *(Atom *)p;
+                XFree(p);
+        }
+        return atom;
+}
+
+
+void kill_window(const char* args)
+{
+        Dael_Client* client;
+        (void) args;
+
+        if (!wm.current_workspace || !(client = wm.current_workspace->focused))
+                return;
+
+        /* asking again skips the wait for the current stage */
+        escalate_kill(client);
+}
+
+
+/*
+ * Closing a window gets less polite each time the client ignores it:
+ * 1. WM_DELETE_WINDOW, skipped if the client does not support it or is
+ *    known to be hung
+ * 2. SIGTERM to its _NET_WM_PID, only for clients on this machine
+ * 3. XKillClient
+ * Stages 1 and 2 give the client KILL_TIMEOUT to go away. After the
+ * first stage that only goes on by itself when the client is hung or did
+ * not answer the ping, a client that is still responding may be asking
+ * the user something and gets escalated by the next kill_window. No stage
+ * grabs the server or waits for the client.
+ */
+void escalate_kill(Dael_Client* c)
+{
+        pid_t pid;
+
+        c->kill_pending = false;
+        switch (c->kill_stage++) {
+        case 0:
+                if (!c->is_hung && send_event(c, ATOM_WM_DELETE_WINDOW)) {
+                        ping_client(c);
+                        break;
+                }
+                c->kill_stage++;
+                /* fall through */
+        case 1:
+                if ((pid = get_window_pid(c)) > 0 && is_local_client(c)
+                && !kill(pid, SIGTERM))
+                        break;
+                c->kill_stage++;
+                /* fall through */
+        default:
+                /* the stand-ins of a replay belong to dael's own
+                 * connection */
+                if (!wm.replaying)
+                        wm.backend->kill_client(c->win);
+                return;
+        }
+        c->kill_pending = true;
+        time_after(&c->kill_deadline, KILL_TIMEOUT);
+        schedule_client_timer(&c->kill_deadline);
+}
+
+
+/* 0 if the client does not say */
+pid_t get_window_pid(Dael_Client* c)
+{
+        Atom type;
+        int format;
+        unsigned long len;
+        unsigned long remaining;
+        unsigned char* p = NULL;
+        pid_t pid = 0;
+
+        wm.stats.round_trips++;
+        if (wm.backend->get_property(c->win, wm.atoms[ATOM_NET_WM_PID], 0L, 1L,
+                False, XA_CARDINAL, &type, &format, &len, &remaining, &p) == Success
+        && p) {
+                if (format == 32 && len == 1)
+                        pid = (pid_t) *(long*) p;
+                XFree(p);
+        }
+        return pid;
+}
+
+
+/* a pid only means something on the machine the client runs on */
+bool is_local_client(Dael_Client* c)
+{
+        Atom type;
+        int format;
+        unsigned long len;
+        unsigned long remaining;
+        unsigned char* p = NULL;
+        char host[256];
+        bool local = false;
+
+        if (gethostname(host, sizeof(host)) < 0)
+                return false;
+        host[sizeof(host) - 1] = '\0';
+
+        wm.stats.round_trips++;
+        if (wm.backend->get_property(c->win, XA_WM_CLIENT_MACHINE, 0L, 64L, False,
+                XA_STRING, &type, &format, &len, &remaining, &p) == Success && p) {
+                local = format == 8 && strlen(host) == len && !memcmp(host, p, len);
+                XFree(p);
+        }
+        return local;
+}
+
+
+/*
+ * Re-execute dael without letting go of any windows. The workspace and
+ * client lists are stored on the root window first, and the new process
+ * rebuilds them from there with its geometry caches intact, so nothing
+ * gets unmapped or reconfigured across the restart.
+ */
+void restart(const char* args)
+{
+        const char* trace_path;
+
+        (void) args;
+
+        if (wm.replaying)
+                return;
+        save_state();
+        XSync(wm.dpy, False);
+        wm.stats.round_trips++;
+        /* the new image appends to the same trace */
+        trace_path = wm.trace ? wm.trace->path : NULL;
+        close_trace();
+        execvp(dael_argv[0], dael_argv);
+
+        perror("execvp");
+        wm.backend->delete_property(wm.root, wm.atoms[ATOM_DAEL_STATE]);
+        if (trace_path)
+                open_trace(trace_path);
+}
+
+
+void save_state(void)
+{
+        Dael_Workspace* ws;
+        Dael_Client* c;
+        unsigned long len = STATE_HEADER_LEN;
+        unsigned long n_ws = 0;
+        unsigned long cur = 0;
+        long* data;
+        long* p;
+
+        for (ws = wm.workspaces; ws; ws = ws->next) {
+                if (ws == wm.current_workspace)
+                        cur = n_ws;
+                n_ws++;
+                len += STATE_WORKSPACE_LEN;
+                for (c = ws->clients; c; c = c->next)
+                        len += STATE_CLIENT_LEN;
+        }
+
+        if (!(data = malloc(len * sizeof(long)))) {
+                fprintf(stderr, "dael: cannot save state\n");
+                return;
+        }
+
+        p = data;
+        *p++ = STATE_VERSION;
+        *p++ = n_ws;
+        *p++ = cur;
+
+        for (ws = wm.workspaces; ws; ws = ws->next) {
+                long* count;
+                long* focused;
+                long i = 0;
+
+                *p++ = ws->id;
+                *p++ = ws->master_size;
+                *p++ = ws->mode;
+                count = p++;
+                focused = p++;
+                *focused = 0;
+                *p++ = ws->monitor;
+
+                for (c = ws->clients; c; c = c->next) {
+                        if (c == ws->focused)
+                                *focused = i + 1;
+                        i++;
+                        *p++ = c->win;
+                        *p++ = (c->is_floating ? STATE_FLOATING : 0)
+                             | (c->is_fullscreen ? STATE_FULLSCREEN : 0);
+                        *p++ = c->geom.x;
+                        *p++ = c->geom.y;
+                        *p++ = c->geom.w;
+                        *p++ = c->geom.h;
+                        *p++ = c->geom.border_width;
+                        *p++ = c->geom.border_color;
+                        *p++ = c->float_geom.x;
+                        *p++ = c->float_geom.y;
+                        *p++ = c->float_geom.w;
+                        *p++ = c->float_geom.h;
+                }
+                *count = i;
+        }
+
+        wm.backend->change_property(wm.root, wm.atoms[ATOM_DAEL_STATE], XA_CARDINAL,
+                        32, PropModeReplace, (unsigned char*) data, len);
+        free(data);
+}
+
+
+/* returns true if a state left behind by restart() was picked up */
+bool restore_state(void)
+{
+        Atom type;
+        int format;
+        unsigned long len;
+        unsigned long remaining;
+        unsigned char* p = NULL;
+
+        if (wm.backend->get_property(wm.root, wm.atoms[ATOM_DAEL_STATE], 0L, ~0L, True,
+                XA_CARDINAL, &type, &format, &len, &remaining, &p) != Success || !p)
+                return false;
+
+        if (format == 32 && len >= STATE_HEADER_LEN
+        && ((long*) p)[0] == STATE_VERSION)
+                restore_workspaces((long*) p, len);
+
+        XFree(p);
+        return wm.workspaces != NULL;
+}
+
+
+void restore_workspaces(const long* data, unsigned long len)
+{
+        Window root_ret;
+        Window parent_ret;
+        Window* children = NULL;
+        unsigned int n_children = 0;
+        unsigned long n_ws = data[1];
+        unsigned long cur = data[2];
+        unsigned long pos = STATE_HEADER_LEN;
+        unsigned long i;
+        Dael_Workspace* last = NULL;
+
+        /* windows may have gone away while no one was managing them */
+        if (!XQueryTree(wm.dpy, wm.root, &root_ret, &parent_ret, &children, &n_children))
+                return;
+        qsort(children, n_children, sizeof(Window), compare_windows);
+
+        for (i = 0; i < n_ws && pos + STATE_WORKSPACE_LEN <= len; i++) {
+                Dael_Workspace* ws = alloc_workspace(data[pos]);
+                unsigned long n_clients = data[pos + 3];
+                unsigned long focused = data[pos + 4];
+                unsigned long j;
+
+                ws->master_size = data[pos + 1];
+                ws->mode = data[pos + 2] % MODE_COUNT;
+                /* the outputs are checked again by update_monitors */
+                ws->monitor = (int) (unsigned int) data[pos + 5];
+                if (ws->monitor < 0 || ws->monitor >= MAX_MONITORS)
+                        ws->monitor = -1;
+                pos += STATE_WORKSPACE_LEN;
+
+                for (j = 0; j < n_clients && pos + STATE_CLIENT_LEN <= len; j++) {
+                        const long* cd = &data[pos];
+                        Window win = (Window) cd[0];
+                        Dael_Client* c;
+
+                        pos += STATE_CLIENT_LEN;
+                        if (!bsearch(&win, children, n_children, sizeof(Window), compare_windows)
+                        || get_client(win))
+                                continue;
+
+                        c = attach_client(ws, win);
+                        c->is_floating = (cd[1] & STATE_FLOATING) != 0;
+                        c->is_fullscreen = (cd[1] & STATE_FULLSCREEN) != 0;
+                        /* values went through 32 bit items, restore the sign */
+                        c->geom.x = (int) (unsigned int) cd[2];
+                        c->geom.y = (int) (unsigned int) cd[3];
+                        c->geom.w = (int) (unsigned int) cd[4];
+                        c->geom.h = (int) (unsigned int) cd[5];
+                        c->geom.border_width = (int) (unsigned int) cd[6];
+                        c->geom.border_color = (int) (unsigned int) cd[7];
+                        set_rect(&c->float_geom, (int) (unsigned int) cd[8],
+                                 (int) (unsigned int) cd[9], (int) (unsigned int) cd[10],
+                                 (int) (unsigned int) cd[11], 0);
+                        c->is_hidden = ws->monitor < 0;
+                        if (j + 1 == focused)
+                                ws->focused = c;
+                        wm.backend->select_input(win, PropertyChangeMask);
+                }
+                if (!ws->focused)
+                        ws->focused = ws->clients;
+
+                if (last) {
+                        last->next = ws;
+                        ws->prev = last;
+                }
+                else {
+                        wm.workspaces = ws;
+                }
+                if (i == cur || !wm.current_workspace)
+                        wm.current_workspace = ws;
+                last = ws;
+        }
+
+        if (children)
+                XFree(children);
+
+        if (wm.current_workspace) {
+                if (wm.current_workspace->monitor >= 0)
+                        wm.selected_monitor = wm.current_workspace->monitor;
+                if (wm.current_workspace->focused)
+                        set_window_focus(wm.current_workspace->focused);
+                request_layout(wm.current_workspace);
+        }
+}
+
+
+int compare_windows(const void* a, const void* b)
+{
+        Window wa = *(const Window*) a;
+        Window wb = *(const Window*) b;
+        return (wa > wb) - (wa < wb);
+}
+
+
+/*
+ * program is a command line, split by split_args. posix_spawn does not
+ * copy dael's address space the way fork does, so a launch costs about
+ * the same no matter how large dael has grown. Everything dael's own
+ * setup changed is put back through the spawn attributes.
+ */
+void launch_program(const char* program)
+{
+        char line[LAUNCH_MAX_LEN];
+        char* argv[LAUNCH_MAX_ARGS + 1];
+        char startup_id[sizeof(STARTUP_ENV) + STARTUP_ID_LEN];
+        posix_spawnattr_t attr;
+        sigset_t set;
+        struct timespec start;
+        char** env;
+        size_t n = 0;
+        pid_t pid;
+        int err;
+
+        /* a replay only measures dael itself */
+        if (wm.replaying)
+                return;
+        if (program && strlen(program) >= sizeof(line)) {
+                fprintf(stderr, "dael: command line too long\n");
+                return;
+        }
+        strcpy(line, (program) ? program : "");
+        if (!split_args(line, argv, LAUNCH_MAX_ARGS)) {
+                fprintf(stderr, "dael: launch_program: missing command\n");
+                return;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        /* toolkits that do startup notification put this on their first
+         * window as _NET_STARTUP_ID, which finds the launch when the
+         * window belongs to some other process than the one started */
+        sprintf(startup_id, STARTUP_ENV "dael-%ld-%lu_TIME0",
+                (long) getpid(), ++wm.launch_seq);
+        while (environ[n])
+                n++;
+        if (!(env = malloc((n + 2) * sizeof(char*)))) {
+                fprintf(stderr, "dael: cannot launch %s\n", argv[0]);
+                return;
+        }
+        for (n = 0; environ[n]; n++)
+                env[n] = (strncmp(environ[n], STARTUP_ENV, strlen(STARTUP_ENV)))
+                       ? environ[n] : startup_id;
+        if (!getenv("DESKTOP_STARTUP_ID"))
+                env[n++] = startup_id;
+        env[n] = NULL;
+
+        posix_spawnattr_init(&attr);
+        /* signals blocked for the signalfd stay blocked across exec */
+        sigemptyset(&set);
+        posix_spawnattr_setsigmask(&attr, &set);
+        sigaddset(&set, SIGCHLD);
+        posix_spawnattr_setsigdefault(&attr, &set);
+        /* a session of its own like the setsid() dael used to do after
+         * fork, so the terminal dael runs in does not reach it. A libc
+         * without the flag gives it a process group of its own in dael's
+         * session instead */
+#ifdef POSIX_SPAWN_SETSID
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK
+                                 | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSID);
+#else
+        posix_spawnattr_setpgroup(&attr, 0);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK
+                                 | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+#endif
+
+        if ((err = posix_spawnp(&pid, argv[0], NULL, &attr, argv, env)))
+                fprintf(stderr, "dael: %s: %s\n", argv[0], strerror(err));
+        posix_spawnattr_destroy(&attr);
+        free(env);
+
+        record_timing(&wm.stats.launches, &start, wm.backend->next_request());
+        if (!err)
+                record_launch(pid, argv[0], startup_id + strlen(STARTUP_ENV), &start);
+}
+
+
+/*
+ * Remembers where pid was launched from for LAUNCH_TIMEOUT seconds. When
+ * every slot is taken the oldest launch is forgotten.
+ */
+Dael_Launch* record_launch(pid_t pid, const char* program, const char* startup_id,
+                           const struct timespec* start)
+{
+        Dael_Launch* l = &wm.launches[0];
+        Dael_Program* prog;
+        const char* name = strrchr(program, '/');
+        int i;
+
+        expire_launches();
+        for (i = 0; i < MAX_LAUNCHES; i++) {
+                if (!wm.launches[i].pid) {
+                        l = &wm.launches[i];
+                        break;
+                }
+                if (compare_time(&wm.launches[i].start, &l->start) < 0)
+                        l = &wm.launches[i];
+        }
+        name = (name) ? name + 1 : program;
+        l->pid = pid;
+        l->ws_id = (wm.current_workspace) ? wm.current_workspace->id : 0;
+        l->mapped = false;
+        l->start = *start;
+        strncpy(l->name, name, PROGRAM_NAME_LEN - 1);
+        l->name[PROGRAM_NAME_LEN - 1] = '\0';
+        strncpy(l->startup_id, startup_id, STARTUP_ID_LEN - 1);
+        l->startup_id[STARTUP_ID_LEN - 1] = '\0';
+
+        if ((prog = program_stats(l->name)))
+                prog->launches++;
+        return l;
+}
+
+
+/*
+ * Forgets launches older than LAUNCH_TIMEOUT. Done when a window is
+ * matched rather than with a timer each, so pending launches cannot use
+ * up the timers kill_window and the layout throttle depend on.
+ */
+void expire_launches(void)
+{
+        struct timespec now;
+        int i;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (i = 0; i < MAX_LAUNCHES; i++)
+                if (wm.launches[i].pid
+                && now.tv_sec - wm.launches[i].start.tv_sec >= LAUNCH_TIMEOUT)
+                        wm.launches[i].pid = 0;
+}
+
+
+/* whether a launch still waits for its window to go to workspace ws_id */
+bool launch_pending(unsigned int ws_id)
+{
+        int i;
+
+        for (i = 0; i < MAX_LAUNCHES; i++)
+                if (wm.launches[i].pid && wm.launches[i].ws_id == ws_id)
+                        return true;
+        return false;
+}
+
+
+/*
+ * The launch a new window came from, matched by _NET_WM_PID and then by
+ * _NET_STARTUP_ID. Costs a round trip for each property, none while
+ * nothing was launched in the last LAUNCH_TIMEOUT seconds.
+ */
+Dael_Launch* find_launch(Window win)
+{
+        Atom type;
+        int format;
+        unsigned long len;
+        unsigned long remaining;
+        unsigned char* p = NULL;
+        Dael_Launch* found = NULL;
+        int i;
+
+        expire_launches();
+        for (i = 0; i < MAX_LAUNCHES && !wm.launches[i].pid; i++);
+        if (i == MAX_LAUNCHES)
+                return NULL;
+
+        wm.stats.round_trips++;
+        if (wm.backend->get_property(win, wm.atoms[ATOM_NET_WM_PID], 0L, 1L, False,
+                XA_CARDINAL, &type, &format, &len, &remaining, &p) == Success && p) {
+                if (format == 32 && len == 1)
+                        for (i = 0; i < MAX_LAUNCHES && !found; i++)
+                                if (wm.launches[i].pid
+                                && wm.launches[i].pid == (pid_t) *(long*) p)
+                                        found = &wm.launches[i];
+                XFree(p);
+                p = NULL;
+        }
+        if (found)
+                return found;
+
+        wm.stats.round_trips++;
+        if (wm.backend->get_property(win, wm.atoms[ATOM_NET_STARTUP_ID], 0L,
+                STARTUP_ID_LEN / 4, False, AnyPropertyType,
+                &type, &format, &len, &remaining, &p) == Success && p) {
+                if (format == 8)
+                        for (i = 0; i < MAX_LAUNCHES && !found; i++)
+                                if (wm.launches[i].pid
+                                && strlen(wm.launches[i].startup_id) == len
+                                && !memcmp(wm.launches[i].startup_id, p, len))
+                                        found = &wm.launches[i];
+                XFree(p);
+        }
+        return found;
+}
+
+
+/* NULL once MAX_PROGRAMS different programs were seen */
+Dael_Program* program_stats(const char* name)
+{
+        Dael_Program* prog;
+        int i;
+
+        for (i = 0; i < wm.stats.program_count; i++)
+                if (!strcmp(wm.stats.programs[i].name, name))
+                        return &wm.stats.programs[i];
+        if (wm.stats.program_count == MAX_PROGRAMS)
+                return NULL;
+
+        prog = &wm.stats.programs[wm.stats.program_count++];
+        strcpy(prog->name, name);
+        return prog;
+}
+
+
+/*
+ * Splits line in place into at most max words, shell style: words are
+ * separated by blanks, '...' is taken literally, "..." and a bare
+ * backslash escape the next character. argv is NULL terminated, returns
+ * the number of words.
+ */
+int split_args(char* line, char** argv, int max)
+{
+        char* in = line;
+        char* out = line;
+        int argc = 0;
+
+        for (;;) {
+                char quote = 0;
+
+                while (*in == ' ' || *in == '\t')
+                        in++;
+                if (!*in)
+                        break;
+                if (argc == max) {
+                        fprintf(stderr, "dael: too many arguments\n");
+                        break;
+                }
+
+                argv[argc++] = out;
+                for (; *in && (quote || (*in != ' ' && *in != '\t')); in++) {
+                        if (quote == '\'' && *in != '\'') {
+                                *out++ = *in;
+                        }
+                        else if (*in == quote) {
+                                quote = 0;
+                        }
+                        else if (!quote && (*in == '\'' || *in == '"')) {
+                                quote = *in;
+                        }
+                        else if (*in == '\\' && in[1]) {
+                                *out++ = *++in;
+                        }
+                        else {
+                                *out++ = *in;
+                        }
+                }
+                /* out never passes in, so the terminator cannot clobber
+                 * the next word */
+                if (*in)
+                        in++;
+                *out++ = '\0';
+        }
+
+        argv[argc] = NULL;
+        return argc;
+}
+
+
+void quit(const char* args)
+{
+        (void) args;
+        wm.running = false;
+}
+
+
+void swap_master(const char* args)
+{
+        Dael_Workspace* ws = wm.current_workspace;
+        Dael_Client* master;
+        Dael_Client* focused;
+        Dael_Client* after;
+        (void) args;
+
+        if (!ws)
+                return;
+
+        /* the master is the first tiled client, as in layout_normal */
+        for (master = ws->clients; master && !is_tiled(master); master = master->next)
+                ;
+        focused = ws->focused;
+        if (!master || !focused || focused == master || !is_tiled(focused))
+                return;
+
+        /* swap the list positions, not the windows: everything cached
+         * about a window (geometry, protocols, pings, kill state) lives
+         * in its client and has to stay with it */
+        after = focused->next;
+        move_client_before(ws, focused, master);
+        move_client_before(ws, master, after);
+
+        set_window_focus(ws->focused);
+        request_layout(ws);
+}
+
+
+void focus_next(const char* args)
+{
+        Dael_Client* client;
+        Dael_Client* prev_focused;
+        (void) args;
+
+        if (!wm.current_workspace || !wm.current_workspace->clients)
+                return;
+
+        prev_focused = wm.current_workspace->focused;
+        client = prev_focused->next;
+
+        if (client) {
+                wm.current_workspace->focused = client;
+        }
+        else {
+                wm.current_workspace->focused = wm.current_workspace->clients;
+        }
+
+        set_window_border(prev_focused);
+        set_window_border(wm.current_workspace->focused);
+
+        set_window_focus(wm.current_workspace->focused);
+        request_layout(wm.current_workspace);
+}
+
+
+void focus_prev(const char* args)
+{
+        Dael_Client* prev_focused;
+        (void) args;
+
+        if (!wm.current_workspace || !wm.current_workspace->clients)
+                return;
+
+        prev_focused = wm.current_workspace->focused;
+
+        if (prev_focused->prev) {
+                wm.current_workspace->focused = prev_focused->prev;
+        } else {
+                wm.current_workspace->focused = wm.current_workspace->clients;
+                while (wm.current_workspace->focused->next) {
+                        wm.current_workspace->focused = wm.current_workspace->focused->next;
+                }
+        }
+
+        set_window_border(prev_focused);
+        set_window_border(wm.current_workspace->focused);
+
+        set_window_focus(wm.current_workspace->focused);
+        request_layout(wm.current_workspace);
+}
+
+
+void increase_size(const char* args)
+{
+        (void) args;
+        change_master_size(SIZE_INCREMENT);
+}
+
+
+void decrease_size(const char* args)
+{
+        (void) args;
+        change_master_size(-SIZE_INCREMENT);
+}
+
+
+void change_master_size(int amount)
+{
+        int new_size;
+        int clamped_size;
+
+        if (!wm.current_workspace || wm.current_workspace->mode == MONOCLE)
+                return;
+
+        new_size = wm.current_workspace->master_size + amount;
+        clamped_size = MIN(MASTER_MAX, MAX(MASTER_MIN, new_size));
+        wm.current_workspace->master_size = clamped_size;
+
+        request_layout(wm.current_workspace);
+}
+
+
+void set_window_focus(Dael_Client* client)
+{
+        wm.backend->focus(client->win);
+        wm.backend->raise(client->win);
+        update_active_window(client->win);
+        ping_client(client);
+}
+
+
+void focus_root(void)
+{
+        wm.backend->focus(wm.root);
+        update_active_window(None);
+}
+
+
+/*
+ * The EWMH root properties are kept up to date as things change so
+ * panels and pagers can wait for PropertyNotify instead of polling. Each
+ * is only written when its value actually changed.
+ */
+void setup_ewmh(void)
+{
+        Atom supported[sizeof(supported_atoms) / sizeof(supported_atoms[0])];
+        size_t i;
+
+        for (i = 0; i < sizeof(supported) / sizeof(supported[0]); i++)
+                supported[i] = wm.atoms[supported_atoms[i]];
+        wm.backend->change_property(wm.root, wm.atoms[ATOM_NET_SUPPORTED], XA_ATOM, 32,
+                        PropModeReplace, (unsigned char*) supported, i);
+
+        /* the check window proves a compliant window manager is running */
+        wm.check_win = XCreateSimpleWindow(wm.dpy, wm.root, 0, 0, 1, 1, 0, 0, 0);
+        wm.backend->change_property(wm.check_win, wm.atoms[ATOM_NET_SUPPORTING_WM_CHECK],
+                        XA_WINDOW, 32, PropModeReplace, (unsigned char*) &wm.check_win, 1);
+        wm.backend->change_property(wm.check_win, wm.atoms[ATOM_NET_WM_NAME],
+                        wm.atoms[ATOM_UTF8_STRING], 8, PropModeReplace,
+                        (unsigned char*) "dael", 4);
+        wm.backend->change_property(wm.root, wm.atoms[ATOM_NET_SUPPORTING_WM_CHECK],
+                        XA_WINDOW, 32, PropModeReplace, (unsigned char*) &wm.check_win, 1);
+
+        /* attach_client appends to a fresh list */
+        wm.backend->delete_property(wm.root, wm.atoms[ATOM_NET_CLIENT_LIST]);
+        wm.active_win = None;
+        wm.backend->change_property(wm.root, wm.atoms[ATOM_NET_ACTIVE_WINDOW], XA_WINDOW,
+                        32, PropModeReplace, (unsigned char*) &wm.active_win, 1);
+        wm.current_desktop = -1;
+        wm.desktop_count = -1;
+}
+
+
+/* attach_client appends, only a removal rewrites the whole list */
+void update_client_list(void)
+{
+        Dael_Workspace* ws;
+        Dael_Client* c;
+        Window* wins = malloc((wm.client_pool.in_use + 1) * sizeof(Window));
+        int n = 0;
+
+        if (!wins) {
+                fprintf(stderr, "dael: cannot update _NET_CLIENT_LIST\n");
+                return;
+        }
+        for (ws = wm.workspaces; ws; ws = ws->next)
+                for (c = ws->clients; c; c = c->next)
+                        wins[n++] = c->win;
+        wm.backend->change_property(wm.root, wm.atoms[ATOM_NET_CLIENT_LIST], XA_WINDOW,
+                        32, PropModeReplace, (unsigned char*) wins, n);
+        free(wins);
+}
+
+
+void update_active_window(Window win)
+{
+        if (win == wm.active_win)
+                return;
+        wm.active_win = win;
+        wm.backend->change_property(wm.root, wm.atoms[ATOM_NET_ACTIVE_WINDOW], XA_WINDOW,
+                        32, PropModeReplace, (unsigned char*) &win, 1);
+}
+
+
+/* once per event batch, desktops are workspaces in list order */
+void update_desktops(void)
+{
+        Dael_Workspace* ws;
+        long current = 0;
+        long count = 0;
+
+        for (ws = wm.workspaces; ws; ws = ws->next) {
+                if (ws == wm.current_workspace)
+                        current = count;
+                count++;
+        }
+
+        if (count != wm.desktop_count) {
+                wm.desktop_count = count;
+                wm.backend->change_property(wm.root, wm.atoms[ATOM_NET_NUMBER_OF_DESKTOPS],
+                                XA_CARDINAL, 32, PropModeReplace, (unsigned char*) &count, 1);
+        }
+        if (current != wm.current_desktop) {
+                wm.current_desktop = current;
+                wm.backend->change_property(wm.root, wm.atoms[ATOM_NET_CURRENT_DESKTOP],
+                                XA_CARDINAL, 32, PropModeReplace, (unsigned char*) &current, 1);
+        }
+}
+
+
+/*
+ * Asks the client to answer a _NET_WM_PING within PING_TIMEOUT. One that
+ * does not is marked hung until it answers. Clients without the protocol
+ * are never pinged and never considered hung.
+ */
+void ping_client(Dael_Client* c)
+{
+        if (c->ping_pending || !send_event(c, ATOM_NET_WM_PING))
+                return;
+        c->ping_pending = true;
+        time_after(&c->ping_deadline, PING_TIMEOUT);
+        schedule_client_timer(&c->ping_deadline);
+}
+
+
+/*
+ * Pings and kill stages keep their deadline in the client, one timer
+ * goes off for the earliest of them. However many clients are waiting,
+ * they take a single slot of the timer table.
+ */
+void schedule_client_timer(const struct timespec* when)
+{
+        if (wm.client_timer >= 0
+        && compare_time(&wm.timers[wm.client_timer].when, when) <= 0)
+                return;
+        cancel_timer(wm.client_timer);
+        wm.client_timer = add_timer_at(when, client_timeout, NULL);
+}
+
+
+void client_timeout(void* arg)
+{
+        Dael_Workspace* ws;
+        Dael_Client* c;
+        struct timespec now;
+        const struct timespec* next = NULL;
+        (void) arg;
+
+        wm.client_timer = -1;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        for (ws = wm.workspaces; ws; ws = ws->next) {
+                for (c = ws->clients; c; c = c->next) {
+                        if (c->ping_pending && compare_time(&c->ping_deadline, &now) <= 0) {
+                                c->ping_pending = false;
+                                if (!c->is_hung) {
+                                        c->is_hung = true;
+                                        if (c->geom.border_width > 0)
+                                                set_window_border(c);
+                                }
+                        }
+                        if (c->kill_pending && compare_time(&c->kill_deadline, &now) <= 0) {
+                                if (c->kill_stage > 1 || c->is_hung || c->ping_pending)
+                                        escalate_kill(c);
+                                else
+                                        c->kill_pending = false;
+                        }
+
+                        if (c->ping_pending && (!next || compare_time(&c->ping_deadline, next) < 0))
+                                next = &c->ping_deadline;
+                        if (c->kill_pending && (!next || compare_time(&c->kill_deadline, next) < 0))
+                                next = &c->kill_deadline;
+                }
+        }
+        if (next)
+                schedule_client_timer(next);
+}
+
+
+/*
+ * The client messages dael acts on, everything it lists in _NET_SUPPORTED
+ * that clients may ask for:
+ *   WM_PROTOCOLS          _NET_WM_PING replies, they come back to the root
+ *   _NET_CURRENT_DESKTOP  switch to the workspace at that position
+ *   _NET_WM_STATE         enter or leave fullscreen
+ *   _NET_ACTIVE_WINDOW    focus a window, showing its workspace
+ */
+void handle_client_message(XEvent* e)
+{
+        XClientMessageEvent* ev = &e->xclient;
+        Atom fullscreen = wm.atoms[ATOM_NET_WM_STATE_FULLSCREEN];
+        Dael_Client* c;
+
+        if (ev->format != 32)
+                return;
+
+        if (ev->window == wm.root) {
+                if (ev->message_type == wm.atoms[ATOM_NET_CURRENT_DESKTOP])
+                        switch_to_desktop(ev->data.l[0]);
+                if (ev->message_type != wm.atoms[ATOM_WM_PROTOCOLS]
+                || (Atom) ev->data.l[0] != wm.atoms[ATOM_NET_WM_PING]
+                || !(c = get_client((Window) ev->data.l[2])))
+                        return;
+        }
+        else {
+                if (!(c = get_client(ev->window)))
+                        return;
+                if (ev->message_type == wm.atoms[ATOM_NET_WM_STATE]
+                && ((Atom) ev->data.l[1] == fullscreen || (Atom) ev->data.l[2] == fullscreen))
+                        set_fullscreen(c, ev->data.l[0] == NET_WM_STATE_TOGGLE
+                                          ? !c->is_fullscreen
+                                          : ev->data.l[0] == NET_WM_STATE_ADD);
+                else if (ev->message_type == wm.atoms[ATOM_NET_ACTIVE_WINDOW])
+                        activate_client(c);
+                return;
+        }
+
+        c->ping_pending = false;
+        if (c->is_hung) {
+                c->is_hung = false;
+                if (c->geom.border_width > 0)
+                        set_window_border(c);
+        }
+}
+
+
+void set_fullscreen(Dael_Client* c, bool fullscreen)
+{
+        if (c->is_fullscreen == fullscreen)
+                return;
+        c->is_fullscreen = fullscreen;
+        if (fullscreen)
+                wm.backend->raise(c->win);
+        set_client_state(c, c->is_hidden ? IconicState : NormalState);
+        request_layout(c->ws);
+}
+
+
+void activate_client(Dael_Client* c)
+{
+        Dael_Workspace* ws = c->ws;
+        Dael_Client* prev = ws->focused;
+
+        ws->focused = c;
+        if (ws != wm.current_workspace) {
+                if (ws->monitor >= 0) {
+                        /* already shown, only the output changes as in
+                         * next_monitor */
+                        request_layout(wm.current_workspace);
+                        wm.selected_monitor = ws->monitor;
+                        wm.current_workspace = ws;
+                }
+                else {
+                        switch_workspace(ws);
+                }
+        }
+
+        set_window_border(prev);
+        set_window_border(c);
+        set_window_focus(c);
+        request_layout(ws);
+}
+
+
+/* desktops are the workspaces in list order, see update_desktops */
+void switch_to_desktop(long n)
+{
+        Dael_Workspace* ws;
+
+        for (ws = wm.workspaces; ws && n > 0; ws = ws->next)
+                n--;
+        if (ws && n == 0 && ws != wm.current_workspace)
+                switch_workspace(ws);
+}
+
+
+/* laid out by the tiling, the rest floats or covers its output */
+bool is_tiled(const Dael_Client* c)
+{
+        return !c->is_floating && !c->is_fullscreen;
+}
+
+
+/* a client that starts floating goes above the tiled ones, after that
+ * only focus changes its place in the stack */
+void update_window_type(Dael_Client* c)
+{
+        Atom atom = get_window_atom_property(c, wm.atoms[ATOM_NET_WM_WINDOW_TYPE]);
+        bool was_floating = c->is_floating;
+
+        c->is_floating = (atom == wm.atoms[ATOM_NET_WM_WINDOW_TYPE_DIALOG]);
+        if (c->is_floating && !was_floating)
+                wm.backend->raise(c->win);
+}
+
+
+void setup_event_handlers(void)
+{
+        Dael_EventHandler* h;
+        for (h = event_handlers; h->handler; h++)
+                handler_table[h->event_type] = h->handler;
+}
+
+
+void handle_event(XEvent* e)
+{
+        struct timespec start;
+        unsigned long first_request;
+
+        if (wm.trace)
+                trace_event(e, e->type);
+
+        /* extension events have no fixed type, see Dael_State_init */
+        if (wm.screen_change_event >= 0 && e->type == wm.screen_change_event) {
+                handle_screen_change(e);
+                return;
+        }
+        if (e->type < 0 || e->type >= LASTEvent)
+                return;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        first_request = wm.backend->next_request();
+
+        if (handler_table[e->type])
+                handler_table[e->type](e);
+
+        record_timing(&wm.stats.events[e->type], &start, first_request);
+}
+
+
+void handle_property_notify(XEvent* e)
+{
+        Dael_Client* c;
+        XPropertyEvent* ev = &e->xproperty;
+
+        /* most property changes are of no interest, drop them before
+         * doing any lookups */
+        if (ev->atom != wm.atoms[ATOM_NET_WM_WINDOW_TYPE]
+        && ev->atom != wm.atoms[ATOM_WM_PROTOCOLS])
+                return;
+
+        if (!(c = get_client(ev->window)))
+                return;
+
+        if (ev->atom == wm.atoms[ATOM_WM_PROTOCOLS])
+                c->protocols_known = false;
+        else
+                update_window_type(c);
+}
+
+
+/*
+ * Windows dael does not manage (yet) get what they ask for. Floating
+ * clients get their size and position, which then sticks across layouts.
+ * Tiled clients keep the geometry the layout gave them and are told so
+ * with a synthetic ConfigureNotify built from the cache, without
+ * touching the window.
+ */
+void handle_configure_request(XEvent* e)
+{
+        XConfigureRequestEvent* ev = &e->xconfigurerequest;
+        Dael_Client* c = get_client(ev->window);
+        XWindowChanges wc;
+        Dael_Rect* f;
+
+        wc.x = ev->x;
+        wc.y = ev->y;
+        wc.width = ev->width;
+        wc.height = ev->height;
+        wc.border_width = ev->border_width;
+        wc.sibling = ev->above;
+        wc.stack_mode = ev->detail;
+
+        if (!c) {
+                wm.backend->configure(ev->window, ev->value_mask, &wc);
+                return;
+        }
+        /* not placed yet, the layout that places it sends the real
+         * geometry. Until then the client is told it got what it asked
+         * for, where it stands, which for a window parked for a hidden
+         * workspace is off-screen */
+        if (c->geom.w < 0) {
+                if (c->geom.x != -1) {
+                        wc.x = c->geom.x;
+                        wc.y = MAX(c->geom.y, 0);
+                }
+                send_synthetic_configure(c->win, wc.x, wc.y, wc.width, wc.height,
+                                         wc.border_width);
+                return;
+        }
+        /* a hidden workspace is parked off-screen, moving one of its
+         * windows would bring it back */
+        if (!c->is_floating || c->is_fullscreen || c->ws->monitor < 0) {
+                send_configure_notify(c);
+                return;
+        }
+
+        f = &c->float_geom;
+        if (!f->w)
+                set_rect(f, c->geom.x, c->geom.y, c->geom.w, c->geom.h, 0);
+        if (ev->value_mask & CWX)
+                f->x = ev->x;
+        if (ev->value_mask & CWY)
+                f->y = ev->y;
+        if (ev->value_mask & CWWidth && ev->width > 0)
+                f->w = ev->width;
+        if (ev->value_mask & CWHeight && ev->height > 0)
+                f->h = ev->height;
+        if (ev->value_mask & (CWSibling | CWStackMode))
+                wm.backend->configure(c->win,
+                                 ev->value_mask & (CWSibling | CWStackMode), &wc);
+
+        /* the server only answers requests that change something */
+        if (f->x == c->geom.x && f->y == c->geom.y
+        && f->w == c->geom.w && f->h == c->geom.h)
+                send_configure_notify(c);
+        else
+                move_resize_client(c, f->x, f->y, f->w, f->h);
+}
+
+
+void send_configure_notify(Dael_Client* c)
+{
+        send_synthetic_configure(c->win, c->geom.x, c->geom.y, c->geom.w, c->geom.h,
+                                 MAX(c->geom.border_width, 0));
+}
+
+
+void send_synthetic_configure(Window win, int x, int y, int w, int h, int border_width)
+{
+        XConfigureEvent ce;
+
+        ce.type = ConfigureNotify;
+        ce.display = wm.dpy;
+        ce.event = win;
+        ce.window = win;
+        ce.x = x;
+        ce.y = y;
+        ce.width = w;
+        ce.height = h;
+        ce.border_width = border_width;
+        ce.above = None;
+        ce.override_redirect = False;
+        wm.backend->send_event(win, StructureNotifyMask, (XEvent*) &ce);
+        wm.stats.configures_synthetic++;
+}
+
+
+void handle_key_press(XEvent* e)
+{
+        XKeyEvent* k = &e->xkey;
+        unsigned int modmask = CLEANMASK(k->state) & (KEYMASK_COUNT - 1);
+        unsigned int i;
+
+        if (k->keycode >= KEYCODE_COUNT)
+                return;
+
+        if ((i = key_table[k->keycode][modmask])) {
+                const Dael_Keybinding* kb = &key_bindings[i - 1];
+                /* with detectable autorepeat a second press without a
+                 * release in between is a repeat */
+                if (k->keycode == wm.held_key && coalesces_repeats(kb->func)) {
+                        wm.layout_throttled = true;
+                        wm.stats.key_repeats++;
+                }
+                wm.held_key = k->keycode;
+                kb->func(kb->arg);
+        }
+}
+
+
+void handle_key_release(XEvent* e)
+{
+        if (e->xkey.keycode != wm.held_key)
+                return;
+        wm.held_key = 0;
+        /* the last repeat is laid out right away */
+        wm.layout_throttled = false;
+}
+
+
+/* bindings whose repeats only change a size, these are rate limited */
+bool coalesces_repeats(void (*func)(const char*))
+{
+        return func == increase_size || func == decrease_size;
+}
+
+
+/* unmaps dael did not cause itself mean the client withdrew its window */
+void handle_unmap_notify(XEvent* e)
+{
+        Dael_Client* c;
+        XUnmapEvent* ev = &e->xunmap;
+
+        if (!(c = get_client(ev->window)))
+                return;
+
+        if (c->ignore_unmap > 0 && !ev->send_event) {
+                c->ignore_unmap--;
+                return;
+        }
+
+        set_client_state(c, WithdrawnState);
+        request_layout(c->ws);
+        remove_client(c->ws, c);
+}
+
+
+void handle_mapping_notify(XEvent* e)
+{
+        XMappingEvent* ev = &e->xmapping;
+
+        XRefreshKeyboardMapping(ev);
+        if (ev->request == MappingKeyboard || ev->request == MappingModifier)
+                setup_keys();
+}
+
+
+void handle_map_request(XEvent* e)
+{
+        XMapRequestEvent* req = &e->xmaprequest;
+        Dael_Workspace* ws;
+        Dael_Client* client;
+
+        /* the server never redirects maps of override-redirect windows,
+         * so there is no need to fetch the attributes (two round trips)
+         * to check for them here */
+        if (get_client(req->window))
+                return;
+
+        ws = place_client(req->window);
+        client = attach_client(ws, req->window);
+        wm.backend->select_input(req->window, PropertyChangeMask);
+
+        /* a window for a hidden workspace is hidden before it is ever
+         * mapped, the way hide_workspace would have left it */
+        if (ws->monitor < 0) {
+                client->is_hidden = true;
+                set_client_state(client, IconicState);
+                if (HIDE_OFFSCREEN) {
+                        client->geom.x = -2 * wm.backend->screen_width();
+                        wm.backend->move(client->win, client->geom.x, 0);
+                        wm.backend->map(req->window);
+                }
+        }
+        else {
+                set_client_state(client, NormalState);
+                /* mapped by apply_layout after it has been given its
+                 * place, so it is drawn at its final size right away */
+                client->needs_map = true;
+        }
+        /* the only round trip left on the map path when nothing was
+         * launched recently, it has to come before the layout as it
+         * decides whether the window floats */
+        update_window_type(client);
+
+        /* focused once it is mapped */
+        ws->focused = client;
+        request_layout(ws);
+}
+
+
+/* the workspace a window was launched from, or the current one */
+Dael_Workspace* place_client(Window win)
+{
+        Dael_Launch* l = find_launch(win);
+        Dael_Workspace* ws = NULL;
+        Dael_Program* prog;
+
+        if (!l)
+                return wm.current_workspace;
+
+        if (!l->mapped) {
+                l->mapped = true;
+                if ((prog = program_stats(l->name)))
+                        record_timing(&prog->map_latency, &l->start, wm.backend->next_request());
+        }
+        /* the workspace may have been reclaimed in the meantime */
+        if (!(ws = find_workspace(l->ws_id)))
+                ws = wm.current_workspace;
+        return ws;
+}
+
+
+void handle_destroy_notify(XEvent* e)
+{
+        Dael_Client* c;
+        XDestroyWindowEvent* ev = &e->xdestroywindow;
+        if ((c = get_client(ev->window))) {
+                Dael_Workspace* ws;
+                if ((ws = get_workspace_for_client(c))) {
+                        /* ws may be reclaimed by remove_client */
+                        request_layout(ws);
+                        remove_client(ws, c);
+                }
+        }
+}
+
+
+/*
+ * Sleeps until the X connection, a signal, a timer or the control socket
+ * has something. Nothing here wakes up on its own: without timers
+ * pending dael stays asleep until it is sent something.
+ */
+void wait_for_input(void)
+{
+        struct pollfd fds[CONTROL_MAX_CONNS + 4];
+        Dael_ControlConn* conns[CONTROL_MAX_CONNS + 4];
+        nfds_t n = 0;
+        nfds_t i;
+
+        fds[n].fd = ConnectionNumber(wm.dpy);
+        fds[n].events = POLLIN;
+        conns[n++] = NULL;
+        fds[n].fd = wm.signal_fd;
+        fds[n].events = POLLIN;
+        conns[n++] = NULL;
+        fds[n].fd = wm.timer_fd;
+        fds[n].events = POLLIN;
+        conns[n++] = NULL;
+
+        if (wm.control_fd >= 0) {
+                fds[n].fd = wm.control_fd;
+                fds[n].events = POLLIN;
+                conns[n++] = NULL;
+        }
+        for (i = 0; i < CONTROL_MAX_CONNS; i++) {
+                if (wm.control[i].fd < 0)
+                        continue;
+                fds[n].fd = wm.control[i].fd;
+                fds[n].events = POLLIN;
+                conns[n++] = &wm.control[i];
+        }
+
+        if (poll(fds, n, -1) < 0)
+                return;
+        wm.stats.wakeups++;
+
+        /* a negative fd is skipped by poll and never has revents */
+        if (fds[1].revents)
+                read_signals();
+        if (fds[2].revents)
+                run_timers();
+
+        for (i = 3; i < n; i++) {
+                if (!fds[i].revents)
                         continue;
+                if (conns[i])
+                        read_control(conns[i]);
+                else
+                        accept_control();
+        }
+}
+
+
+/*
+ * The signals dael cares about are blocked and read from a signalfd in
+ * the main loop, so they are handled between event batches like any
+ * other input:
+ * SIGCHLD          reap children
+ * SIGUSR1          write the stats, see dump_stats
+ * SIGUSR2          reset the stats
+ * SIGINT, SIGTERM  quit
+ */
+void setup_signals(void)
+{
+        struct sigaction sa;
+        sigset_t set;
+
+        /* SIGCHLD may still be ignored by an image that exec'd us, an
+         * ignored signal would never show up on the signalfd */
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = 0;
+        sa.sa_handler = SIG_DFL;
+        sigaction(SIGCHLD, &sa, NULL);
+
+        sigemptyset(&set);
+        sigaddset(&set, SIGCHLD);
+        sigaddset(&set, SIGUSR1);
+        sigaddset(&set, SIGUSR2);
+        sigaddset(&set, SIGINT);
+        sigaddset(&set, SIGTERM);
+        sigprocmask(SIG_BLOCK, &set, NULL);
+
+        if ((wm.signal_fd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC)) < 0)
+                die("failed to create signalfd");
+        if ((wm.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+                die("failed to create timerfd");
+
+        /* children left over from before a restart */
+        while (waitpid(-1, NULL, WNOHANG) > 0);
+}
+
+
+void read_signals(void)
+{
+        struct signalfd_siginfo si;
+
+        while (read(wm.signal_fd, &si, sizeof(si)) == sizeof(si)) {
+                switch (si.ssi_signo) {
+                case SIGCHLD:
+                        while (waitpid(-1, NULL, WNOHANG) > 0);
+                        break;
+                case SIGUSR1:
+                        dump_stats();
+                        break;
+                case SIGUSR2:
+                        reset_stats();
+                        break;
+                default:
+                        wm.running = false;
                 }
+        }
+}
+
+
+/*
+ * Runs func(arg) from the main loop once ms milliseconds have passed.
+ * Returns an id for cancel_timer, or -1 if all MAX_TIMERS are in use.
+ */
+int add_timer(long ms, void (*func)(void* arg), void* arg)
+{
+        struct timespec when;
+
+        time_after(&when, ms);
+        return add_timer_at(&when, func, arg);
+}
+
+
+/* the same for a CLOCK_MONOTONIC time */
+int add_timer_at(const struct timespec* when, void (*func)(void* arg), void* arg)
+{
+        Dael_Timer* t;
+        int i;
+
+        for (i = 0; i < MAX_TIMERS && wm.timers[i].active; i++);
+        if (i == MAX_TIMERS) {
+                fprintf(stderr, "dael: out of timers\n");
+                return -1;
+        }
+
+        t = &wm.timers[i];
+        t->when = *when;
+        t->func = func;
+        t->arg = arg;
+        t->active = true;
+
+        arm_timer_fd();
+        return i;
+}
 
-                get_screen_center(&x, &y);
-                x -= w / 2;
-                y -= h / 2;
 
-                XMoveResizeWindow(wm.dpy, client->win, x, y, w, h);
-                XRaiseWindow(wm.dpy, client->win);
-                set_window_border(client);
+void cancel_timer(int id)
+{
+        if (id < 0 || id >= MAX_TIMERS || !wm.timers[id].active)
+                return;
+        wm.timers[id].active = false;
+        arm_timer_fd();
+}
+
+
+/* a callback may add or cancel timers, including its own slot */
+void run_timers(void)
+{
+        unsigned char expirations[8];
+        struct timespec now;
+        int i;
+
+        /* the load run of test.c has no timerfd */
+        if (wm.timer_fd >= 0
+        && read(wm.timer_fd, expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                perror("dael: timerfd");
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (i = 0; i < MAX_TIMERS; i++) {
+                Dael_Timer* t = &wm.timers[i];
+                if (!t->active || compare_time(&t->when, &now) > 0)
+                        continue;
+                t->active = false;
+                t->func(t->arg);
+        }
+        arm_timer_fd();
+}
+
+
+/* points the timerfd at the earliest timer, or disarms it */
+void arm_timer_fd(void)
+{
+        struct itimerspec its;
+        const struct timespec* next = NULL;
+        int i;
+
+        for (i = 0; i < MAX_TIMERS; i++)
+                if (wm.timers[i].active
+                && (!next || compare_time(&wm.timers[i].when, next) < 0))
+                        next = &wm.timers[i].when;
+
+        /* replays never wait for timers */
+        if (wm.timer_fd < 0)
+                return;
+        memset(&its, 0, sizeof(its));
+        if (next)
+                its.it_value = *next;
+        if (timerfd_settime(wm.timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+                perror("dael: timerfd_settime");
+}
+
 
-                client = client->next;
+/* sets t to ms milliseconds from now */
+void time_after(struct timespec* t, long ms)
+{
+        clock_gettime(CLOCK_MONOTONIC, t);
+        t->tv_sec += ms / 1000;
+        t->tv_nsec += (ms % 1000) * 1000000L;
+        if (t->tv_nsec >= 1000000000L) {
+                t->tv_sec++;
+                t->tv_nsec -= 1000000000L;
         }
 }
 
 
-void tile_normal(int w, int h)
+int compare_time(const struct timespec* a, const struct timespec* b)
 {
-        int mh = 0;
-        int mw = 0;
-        Dael_Client* m;
-        Dael_Client* client;
-        int num_slaves = 0;
-        int msize = wm.current_workspace->master_size;
+        if (a->tv_sec != b->tv_sec)
+                return (a->tv_sec < b->tv_sec) ? -1 : 1;
+        if (a->tv_nsec != b->tv_nsec)
+                return (a->tv_nsec < b->tv_nsec) ? -1 : 1;
+        return 0;
+}
 
-        m = wm.current_workspace->clients;
-        client = m->next;
 
-        while (client) {
-                if (!client->is_floating)
-                        num_slaves++;
-                client = client->next;
+/*
+ * Starts recording every event handled to path. The file is appended to,
+ * so a restart keeps writing to the same trace. The writes are left to a
+ * writer process behind a socket: dael only ever sends to it without
+ * waiting, so a slow disk holds up the trace but not the event loop.
+ */
+void open_trace(const char* path)
+{
+        Dael_TraceHeader h;
+        int sv[2];
+        int out;
+        int size = TRACE_BUFSIZE * 16;
+        bool empty;
+        int i;
+
+        if ((out = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600)) < 0) {
+                perror(path);
+                return;
         }
-
-        if (num_slaves == 0) {
-                tile_monocle(w, h);
+        empty = (lseek(out, 0, SEEK_END) == 0);
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+                perror("dael: trace");
+                close(out);
                 return;
         }
+        if (!(wm.trace = malloc(sizeof(Dael_Trace)))
+        || !(wm.trace->buf = malloc(TRACE_BUFSIZE))) {
+                fprintf(stderr, "dael: cannot allocate the trace buffer\n");
+                free(wm.trace);
+                wm.trace = NULL;
+                close(sv[0]);
+                close(sv[1]);
+                close(out);
+                return;
+        }
+        /* room for a few batches while the writer is busy, the buffer
+         * here takes the rest */
+        setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+        if ((wm.trace->writer = fork()) < 0) {
+                perror("dael: trace");
+                close(sv[0]);
+                close(sv[1]);
+                close(out);
+                free(wm.trace->buf);
+                free(wm.trace);
+                wm.trace = NULL;
+                return;
+        }
+        if (!wm.trace->writer) {
+                close(sv[0]);
+                trace_writer(sv[1], out);
+        }
+        close(sv[1]);
+        close(out);
+        fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+
+        wm.trace->fd = sv[0];
+        wm.trace->path = path;
+        wm.trace->pending = false;
+        wm.trace->len = 0;
+        wm.trace->size = TRACE_BUFSIZE;
+
+        if (empty) {
+                memset(&h, 0, sizeof(h));
+                memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+                h.event_size = sizeof(XEvent);
+                h.root = wm.root;
+                for (i = 0; i < ATOM_COUNT; i++)
+                        h.atoms[i] = wm.atoms[i];
+                memcpy(wm.trace->buf, &h, sizeof(h));
+                wm.trace->len = sizeof(h);
+        }
+}
 
-        /* master window takes left half of display */
-        mw = (w * msize) / 100;
-        mh = h;
-        mw -= BORDER_SIZE * 2;
-        mh -= BORDER_SIZE * 2;
-
-        set_window_border(m);
-        XMoveResizeWindow(wm.dpy, m->win, 0, 0, mw, mh);
-
-        if (num_slaves > 0) {
-                int cw = (w - mw) - BORDER_SIZE * 2;
-                int total_height = h - (num_slaves * BORDER_SIZE * 2);
-                int ch = total_height / num_slaves;
-                int extra_space = total_height % num_slaves;
-                int cx = mw;
-                int cy = 0;
-                client = m->next;
-
-                while (client) {
-                        int height = ch;
 
-                        if (client->is_floating) {
-                                client = client->next;
+/* the writer process, copies what dael sends to the file until dael
+ * closes its end */
+void trace_writer(int in, int out)
+{
+        char buf[TRACE_BUFSIZE];
+        ssize_t n;
+        ssize_t done;
+        ssize_t w;
+
+        while ((n = read(in, buf, sizeof(buf))) != 0) {
+                if (n < 0) {
+                        if (errno == EINTR)
                                 continue;
+                        perror("dael: trace writer");
+                        _exit(1);
+                }
+                done = 0;
+                while (done < n) {
+                        if ((w = write(out, buf + done, n - done)) >= 0) {
+                                done += w;
                         }
-
-                        set_window_border(client);
-
-                        if (extra_space > 0) {
-                                height += 1;
-                                extra_space--;
+                        else if (errno != EINTR) {
+                                /* dael finds out from the closed socket */
+                                perror("dael: trace writer");
+                                _exit(1);
                         }
-                        XMoveResizeWindow(wm.dpy, client->win, cx, cy, cw, height);
-                        cy += height + (BORDER_SIZE * 2);
-                        client = client->next;
                 }
         }
+        _exit(0);
 }
 
 
-/* in monocle mode, the focused window is the master window
- * and fills the entirety of the screen */
-void tile_monocle(int w, int h)
+/*
+ * Makes room for size more bytes in the buffer, growing it while the
+ * writer lags behind. A trace with a hole in it would not replay, so
+ * tracing stops when the writer is gone or too far behind.
+ */
+bool trace_room(size_t size)
 {
-        Dael_Client* c = wm.current_workspace->clients;
-
-        while (c) {
-                if (!c->is_floating) {
-                        remove_window_border(c);
-                        XMoveResizeWindow(wm.dpy, c->win, 0, 0, w, h);
-                }
-                c = c->next;
+        char* buf;
+
+        if (wm.trace->len + size <= wm.trace->size)
+                return true;
+        flush_trace();
+        if (!wm.trace)
+                return false;
+        if (wm.trace->len + size <= wm.trace->size)
+                return true;
+
+        if (wm.trace->size * 2 <= TRACE_BUFMAX
+        && (buf = realloc(wm.trace->buf, wm.trace->size * 2))) {
+                wm.trace->buf = buf;
+                wm.trace->size *= 2;
+                return true;
         }
+        fprintf(stderr, "dael: the trace writer fell behind, tracing stopped\n");
+        stop_trace(false);
+        return false;
 }
 
 
-/* adopted from dwm.c from suckless */
-int send_event(Dael_Client* c, Atom proto)
+/* e is NULL for a TRACE_BATCH_END record */
+void trace_event(const XEvent* e, int type)
 {
-        int n;
-        Atom* protocols;
-        Atom wm_protocols = XInternAtom(wm.dpy, "WM_PROTOCOLS", False);
-        int exists = 0;
-        XEvent e;
+        Dael_TraceRecord r;
+        struct timespec now;
 
-        if (XGetWMProtocols(wm.dpy, c->win, &protocols, &n)) {
-                while (!exists && n--)
-                        exists = protocols[n] == proto;
-                XFree(protocols);
-        }
-        if (exists) {
-                e.type = ClientMessage;
-                e.xclient.window = c->win;
-                e.xclient.message_type = wm_protocols;
-                e.xclient.format = 32;
-                e.xclient.data.l[0] = proto;
-		e.xclient.data.l[1] = CurrentTime;
-                XSendEvent(wm.dpy, c->win, False, NoEventMask, &e);
-        }
-        return exists;
+        if (!trace_room(sizeof(r)))
+                return;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        memset(&r, 0, sizeof(r));
+        r.sec = now.tv_sec;
+        r.nsec = now.tv_nsec;
+        if (e)
+                r.event = *e;
+        r.event.type = type;
+        memcpy(wm.trace->buf + wm.trace->len, &r, sizeof(r));
+        wm.trace->len += sizeof(r);
+        wm.trace->pending = (type != TRACE_BATCH_END);
 }
 
 
-Atom get_window_atom_property(Dael_Client* c, Atom prop)
+/* control commands change the state too, a replay runs them in place */
+void trace_command(const char* line)
 {
-        int dummy_i;
-        unsigned long dummy_l;
-        unsigned char* p = NULL;
-        Atom dummy_a;
-        Atom atom = None;
+        size_t len = strlen(line);
+        XEvent e;
 
-        if (XGetWindowProperty(
-                wm.dpy, c->win, prop, 0L, sizeof atom, False, XA_ATOM,
-                &dummy_a, &dummy_i, &dummy_l, &dummy_l, &p) == Success && p) {
-                atom = *(Atom *)p;
-                XFree(p);
-        }
-        return atom;
+        if (!trace_room(sizeof(Dael_TraceRecord) + len))
+                return;
+        memset(&e, 0, sizeof(e));
+        e.xany.serial = len;
+        trace_event(&e, TRACE_COMMAND);
+        memcpy(wm.trace->buf + wm.trace->len, line, len);
+        wm.trace->len += len;
 }
 
 
-void kill_window(const char* args)
+/* hands the writer as much as it takes without waiting */
+void flush_trace(void)
 {
-        Atom wm_delete = XInternAtom(wm.dpy, "WM_DELETE_WINDOW", False);
-        Dael_Client* client = wm.current_workspace->focused;
-        (void) args;
-        if (!send_event(client, wm_delete)) {
-                XGrabServer(wm.dpy);
-                XSetErrorHandler(xerror_ignore);
-                XSetCloseDownMode(wm.dpy, DestroyAll);
-                XKillClient(wm.dpy, client->win);
-                XSync(wm.dpy, False);
-                XSetErrorHandler(xerror_handler);
-                XUngrabServer(wm.dpy);
+        ssize_t n;
+
+        if (!wm.trace || !wm.trace->len)
+                return;
+        if ((n = send(wm.trace->fd, wm.trace->buf, wm.trace->len,
+                      MSG_DONTWAIT | MSG_NOSIGNAL)) < 0) {
+                if (errno == EAGAIN || errno == EINTR)
+                        return;
+                perror("dael: trace");
+                stop_trace(false);
+                return;
         }
+        wm.trace->len -= n;
+        memmove(wm.trace->buf, wm.trace->buf + n, wm.trace->len);
 }
 
 
-void launch_program(const char* program)
+/* at exit and before a restart, waits until the writer has the whole
+ * trace in the file */
+void close_trace(void)
 {
-        struct sigaction sa;
-        pid_t pid = fork();
-
-        if (pid == 0) {
-                char* argv[] = {NULL, NULL};
-
-                if (wm.dpy)
-			close(ConnectionNumber(wm.dpy));
-		setsid();
-
-		sigemptyset(&sa.sa_mask);
-		sa.sa_flags = 0;
-		sa.sa_handler = SIG_DFL;
-		sigaction(SIGCHLD, &sa, NULL);
+        const char* p;
+        size_t left;
+        ssize_t n;
 
-                argv[0] = (char*) program;
-                execvp(argv[0], argv);
-                perror("execvp");
-                exit(1);
-        }
-        else if (pid < 0) {
-                perror("fork");
+        if (!wm.trace)
+                return;
+        p = wm.trace->buf;
+        left = wm.trace->len;
+        while (left) {
+                if ((n = send(wm.trace->fd, p, left, MSG_NOSIGNAL)) < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        perror("dael: trace");
+                        break;
+                }
+                p += n;
+                left -= n;
         }
+        stop_trace(true);
 }
 
 
-void quit(const char* args)
+/* the writer sees the socket close, writes out what it has and exits,
+ * read_signals reaps it unless this waits for it */
+void stop_trace(bool wait)
 {
-        (void) args;
-        wm.running = false;
+        close(wm.trace->fd);
+        if (wait)
+                while (waitpid(wm.trace->writer, NULL, 0) < 0 && errno == EINTR);
+        free(wm.trace->buf);
+        free(wm.trace);
+        wm.trace = NULL;
 }
 
 
-void swap_master(const char* args)
+/*
+ * Feeds a recorded trace through handle_event and run_command, laying
+ * out and flushing at the recorded batch ends, as fast as possible or at
+ * the recorded pace. The windows of the recording do not exist here,
+ * every window that is asked to be mapped or configured gets a plain
+ * stand-in window instead. The stats printed afterwards show the handler
+ * times and the requests they generated.
+ */
+int replay_trace(const char* path, bool paced)
 {
-        Window tmp;
-        Dael_Client* master = wm.current_workspace->clients;
-        Dael_Client* focused = wm.current_workspace->focused;
-        (void) args;
+        FILE* f = fopen(path, "rb");
+        Dael_TraceHeader h;
+        Dael_TraceRecord r;
+        Dael_ReplayMap map;
+        struct timespec start;
+        struct timespec end;
+        struct timespec first;
+        unsigned long events = 0;
+        unsigned long commands = 0;
+        size_t i;
+
+        if (!f) {
+                perror(path);
+                return 1;
+        }
+        if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, TRACE_MAGIC, sizeof(h.magic))
+        || h.event_size != sizeof(XEvent)) {
+                fprintf(stderr, "dael: %s: not a trace this dael can read\n", path);
+                fclose(f);
+                return 1;
+        }
 
-        if (!master || !focused || focused == master)
-                return;
+        memset(&map, 0, sizeof(map));
+        map.root = h.root;
+        map.atoms = h.atoms;
+        first.tv_sec = -1;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        while (fread(&r, sizeof(r), 1, f) == 1) {
+                if (paced) {
+                        struct timespec at;
+                        if (first.tv_sec < 0) {
+                                first.tv_sec = r.sec;
+                                first.tv_nsec = r.nsec;
+                        }
+                        at.tv_sec = start.tv_sec + (r.sec - first.tv_sec);
+                        at.tv_nsec = start.tv_nsec + (r.nsec - first.tv_nsec);
+                        while (at.tv_nsec < 0) {
+                                at.tv_sec--;
+                                at.tv_nsec += 1000000000L;
+                        }
+                        while (at.tv_nsec >= 1000000000L) {
+                                at.tv_sec++;
+                                at.tv_nsec -= 1000000000L;
+                        }
+                        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL) == EINTR);
+                }
 
-        tmp = master->win;
-        master->win = focused->win;
-        focused->win = tmp;
+                if (r.event.type == TRACE_COMMAND) {
+                        char line[CONTROL_BUFSIZE];
+                        unsigned long len = r.event.xany.serial;
 
-        set_window_focus(wm.current_workspace->focused);
-        apply_layout();
+                        if (len >= sizeof(line) || fread(line, 1, len, f) != len) {
+                                fprintf(stderr, "dael: %s: broken command record\n", path);
+                                break;
+                        }
+                        line[len] = '\0';
+                        if (!strcmp(line, "begin"))
+                                wm.in_block = true;
+                        else if (!strcmp(line, "end"))
+                                wm.in_block = false;
+                        else
+                                run_command(line);
+                        commands++;
+                        continue;
+                }
+                if (r.event.type == TRACE_BATCH_END) {
+                        XEvent discard;
+                        apply_pending_layout();
+                        update_desktops();
+                        XFlush(wm.dpy);
+                        wm.stats.flushes++;
+                        /* the real events the stand-ins cause are not
+                         * part of the replay */
+                        while (XPending(wm.dpy))
+                                XNextEvent(wm.dpy, &discard);
+                        continue;
+                }
+
+                translate_event(&map, &r.event);
+                handle_event(&r.event);
+                events++;
+        }
+        fclose(f);
+
+        /* layouts held back for autorepeat would wait for a timer */
+        wm.layout_throttled = false;
+        apply_pending_layout();
+        XSync(wm.dpy, False);
+        wm.stats.round_trips++;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        printf("replay events %lu commands %lu us %ld\n", events, commands,
+               (long) ((end.tv_sec - start.tv_sec) * 1000000L
+                       + (end.tv_nsec - start.tv_nsec) / 1000));
+
+        for (i = 0; i < map.count; i++)
+                XDestroyWindow(wm.dpy, map.to[i]);
+        free(map.from);
+        free(map.to);
+        return 0;
 }
 
 
-void focus_next(const char* args)
+/* points the ids in a recorded event at this server's windows and atoms */
+void translate_event(Dael_ReplayMap* map, XEvent* e)
 {
-        Dael_Client* client;
-        Dael_Client* prev_focused;
-        (void) args;
+        e->xany.display = wm.dpy;
+        e->xany.window = translate_window(map, e->xany.window, false);
 
-        if (!wm.current_workspace || !wm.current_workspace->clients)
-                return;
+        switch (e->type) {
+        case MapRequest:
+                e->xmaprequest.window = translate_window(map, e->xmaprequest.window, true);
+                break;
+        case ConfigureRequest:
+                e->xconfigurerequest.window =
+                        translate_window(map, e->xconfigurerequest.window, true);
+                e->xconfigurerequest.above =
+                        translate_window(map, e->xconfigurerequest.above, false);
+                break;
+        case DestroyNotify:
+                e->xdestroywindow.window = translate_window(map, e->xdestroywindow.window, false);
+                break;
+        case UnmapNotify:
+                e->xunmap.window = translate_window(map, e->xunmap.window, false);
+                break;
+        case PropertyNotify:
+                e->xproperty.atom = translate_atom(map, e->xproperty.atom);
+                break;
+        case ClientMessage:
+                e->xclient.message_type = translate_atom(map, e->xclient.message_type);
+                if (e->xclient.format != 32)
+                        break;
+                /* what the data holds depends on the message */
+                if (e->xclient.message_type == wm.atoms[ATOM_WM_PROTOCOLS]) {
+                        e->xclient.data.l[0] = translate_atom(map, e->xclient.data.l[0]);
+                        e->xclient.data.l[2] = translate_window(map, e->xclient.data.l[2], false);
+                }
+                else if (e->xclient.message_type == wm.atoms[ATOM_NET_WM_STATE]) {
+                        /* l[0] is the action */
+                        e->xclient.data.l[1] = translate_atom(map, e->xclient.data.l[1]);
+                        e->xclient.data.l[2] = translate_atom(map, e->xclient.data.l[2]);
+                }
+                else if (e->xclient.message_type == wm.atoms[ATOM_NET_ACTIVE_WINDOW]) {
+                        e->xclient.data.l[2] = translate_window(map, e->xclient.data.l[2], false);
+                }
+                break;
+        case KeyPress:
+        case KeyRelease:
+                e->xkey.root = wm.root;
+                break;
+        }
+}
 
-        prev_focused = wm.current_workspace->focused;
-        client = prev_focused->next;
 
-        if (client) {
-                wm.current_workspace->focused = client;
-        }
-        else {
-                wm.current_workspace->focused = wm.current_workspace->clients;
+Window translate_window(Dael_ReplayMap* map, Window win, bool create)
+{
+        size_t i;
+
+        if (win == None)
+                return None;
+        if (win == map->root)
+                return wm.root;
+        for (i = 0; i < map->count; i++)
+                if (map->from[i] == win)
+                        return map->to[i];
+        if (!create)
+                return win;
+
+        if (map->count == map->capacity) {
+                size_t capacity = (map->capacity) ? map->capacity * 2 : 64;
+                Window* from = realloc(map->from, capacity * sizeof(Window));
+                Window* to;
+                if (from)
+                        map->from = from;
+                to = realloc(map->to, capacity * sizeof(Window));
+                if (to)
+                        map->to = to;
+                if (!from || !to)
+                        die("failed to allocate the replay window map");
+                map->capacity = capacity;
         }
+        map->from[map->count] = win;
+        map->to[map->count] = XCreateSimpleWindow(wm.dpy, wm.root, 0, 0,
+                                                  FLOAT_WIDTH, FLOAT_HEIGHT, 0, 0, 0);
+        return map->to[map->count++];
+}
 
-        set_window_border(prev_focused);
-        set_window_border(wm.current_workspace->focused);
 
-        set_window_focus(wm.current_workspace->focused);
-        apply_layout();
+/* dael's own atoms may have other values on this server */
+Atom translate_atom(Dael_ReplayMap* map, Atom atom)
+{
+        int i;
+
+        for (i = 0; i < ATOM_COUNT; i++)
+                if (map->atoms[i] == atom)
+                        return wm.atoms[i];
+        return atom;
 }
 
 
-void focus_prev(const char* args)
+/*
+ * The socket lives in the private runtime directory, one per display. A
+ * socket left behind by a dael that is gone (or that exec'd itself for a
+ * restart) is replaced, one that still accepts connections is left alone
+ * and this dael goes without.
+ */
+void setup_control(void)
 {
-        Dael_Client* prev_focused;
-        (void) args;
-
-        if (!wm.current_workspace || !wm.current_workspace->clients)
+        struct sockaddr_un addr;
+        struct stat st;
+        mode_t mask;
+        int err;
+        int i;
+
+        for (i = 0; i < CONTROL_MAX_CONNS; i++)
+                wm.control[i].fd = -1;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (!runtime_path(addr.sun_path, sizeof(addr.sun_path), CONTROL_SOCKET))
                 return;
+        if (socket_in_use(&addr)) {
+                fprintf(stderr, "dael: %s is in use\n", addr.sun_path);
+                return;
+        }
+        unlink(addr.sun_path);
 
-        prev_focused = wm.current_workspace->focused;
-
-        if (prev_focused->prev) {
-                wm.current_workspace->focused = prev_focused->prev;
-        } else {
-                wm.current_workspace->focused = wm.current_workspace->clients;
-                while (wm.current_workspace->focused->next) {
-                        wm.current_workspace->focused = wm.current_workspace->focused->next;
-                }
+        wm.control_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (wm.control_fd < 0) {
+                perror("dael: socket");
+                return;
         }
 
-        set_window_border(prev_focused);
-        set_window_border(wm.current_workspace->focused);
+        /* created private, there is no moment where others could connect */
+        mask = umask(S_IRWXG | S_IRWXO);
+        err = bind(wm.control_fd, (struct sockaddr*) &addr, sizeof(addr));
+        umask(mask);
 
-        set_window_focus(wm.current_workspace->focused);
-        apply_layout();
+        if (err < 0 || lstat(addr.sun_path, &st) < 0
+        || listen(wm.control_fd, CONTROL_MAX_CONNS) < 0) {
+                perror(addr.sun_path);
+                close(wm.control_fd);
+                wm.control_fd = -1;
+                return;
+        }
+        strcpy(wm.control_path, addr.sun_path);
+        wm.control_dev = st.st_dev;
+        wm.control_ino = st.st_ino;
+        fcntl(wm.control_fd, F_SETFD, FD_CLOEXEC);
+        fcntl(wm.control_fd, F_SETFL, O_NONBLOCK);
 }
 
 
-void increase_size(const char* args)
+bool socket_in_use(const struct sockaddr_un* addr)
 {
-        (void) args;
-        change_master_size(SIZE_INCREMENT);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool used;
+
+        if (fd < 0)
+                return false;
+        used = !connect(fd, (const struct sockaddr*) addr, sizeof(*addr));
+        close(fd);
+        return used;
 }
 
 
-void decrease_size(const char* args)
+void close_control(void)
 {
-        (void) args;
-        change_master_size(-SIZE_INCREMENT);
+        struct stat st;
+        int i;
+
+        for (i = 0; i < CONTROL_MAX_CONNS; i++)
+                if (wm.control[i].fd >= 0)
+                        drop_control(&wm.control[i]);
+
+        if (wm.control_fd >= 0) {
+                close(wm.control_fd);
+                wm.control_fd = -1;
+                /* only if it is still the socket this dael created */
+                if (!lstat(wm.control_path, &st) && st.st_dev == wm.control_dev
+                && st.st_ino == wm.control_ino)
+                        unlink(wm.control_path);
+        }
 }
 
 
-void get_screen_center(int* x, int* y)
+void accept_control(void)
 {
-        int screen_w = DisplayWidth(wm.dpy, DefaultScreen(wm.dpy));
-        int screen_h = DisplayHeight(wm.dpy, DefaultScreen(wm.dpy));
-        *x = screen_w / 2;
-        *y = screen_h / 2;
+        int fd;
+        int i;
+
+        if ((fd = accept(wm.control_fd, NULL, NULL)) < 0)
+                return;
+
+        for (i = 0; i < CONTROL_MAX_CONNS; i++) {
+                if (wm.control[i].fd < 0) {
+                        fcntl(fd, F_SETFD, FD_CLOEXEC);
+                        fcntl(fd, F_SETFL, O_NONBLOCK);
+                        wm.control[i].fd = fd;
+                        wm.control[i].len = 0;
+                        return;
+                }
+        }
+        close(fd); /* no free slot */
 }
 
 
-void change_master_size(int amount)
+void read_control(Dael_ControlConn* conn)
 {
-        int new_size;
-        int clamped_size;
+        ssize_t n;
+        bool eof = false;
 
-        if (wm.current_workspace->mode == MONOCLE)
-                return;
+        n = read(conn->fd, conn->buf + conn->len, sizeof(conn->buf) - conn->len - 2);
+        if (n > 0)
+                conn->len += n;
+        else if (n == 0 || (errno != EAGAIN && errno != EINTR))
+                eof = true;
 
-        new_size = wm.current_workspace->master_size + amount;
-        clamped_size = MIN(MASTER_MAX, MAX(MASTER_MIN, new_size));
-        wm.current_workspace->master_size = clamped_size;
+        process_control(conn, eof);
 
-        apply_layout();
+        if (eof) {
+                drop_control(conn);
+        }
+        else if (conn->len >= sizeof(conn->buf) - 2) {
+                reply_control(conn, "error input too long\n");
+                drop_control(conn);
+        }
 }
 
 
-void set_window_focus(Dael_Client* client)
+/*
+ * The input is one command per line, a function name optionally followed
+ * by its argument. Lines between "begin" and "end" only run once the
+ * "end" has arrived, so a whole block ends up in one event batch and
+ * costs a single layout and flush.
+ */
+void process_control(Dael_ControlConn* conn, bool eof)
 {
-        XSetInputFocus(wm.dpy, client->win, RevertToPointerRoot, CurrentTime);
-        XRaiseWindow(wm.dpy, client->win);
-}
+        char* start = conn->buf;
+        char* end;
+        char reply[64];
+
+        /* read_control always leaves room for a newline and terminator */
+        if (eof && conn->len && conn->buf[conn->len - 1] != '\n')
+                conn->buf[conn->len++] = '\n';
+        end = conn->buf + conn->len;
+        *end = '\0';
+
+        while (start < end) {
+                char* nl = memchr(start, '\n', end - start);
+
+                if (!nl)
+                        break;
+                *nl = '\0';
+
+                if (!strcmp(start, "begin")) {
+                        char* line = nl + 1;
+                        char* block_end = NULL;
+                        int ok = 0;
+                        int failed = 0;
+
+                        if (!strncmp(line, "end\n", 4))
+                                block_end = line;
+                        else if ((block_end = strstr(line, "\nend\n")))
+                                block_end++;
+
+                        /* wait for the rest of the block */
+                        if (!block_end) {
+                                *nl = '\n';
+                                if (eof)
+                                        reply_control(conn, "error unterminated block\n");
+                                break;
+                        }
 
+                        if (wm.trace)
+                                trace_command("begin");
+                        wm.in_block = true;
+                        while (line < block_end) {
+                                char* lnl = memchr(line, '\n', block_end - line);
+                                *lnl = '\0';
+                                if (run_command(line))
+                                        ok++;
+                                else
+                                        failed++;
+                                line = lnl + 1;
+                        }
+                        wm.in_block = false;
+                        if (wm.trace)
+                                trace_command("end");
+                        sprintf(reply, "ok %d failed %d\n", ok, failed);
+                        reply_control(conn, reply);
+                        nl = block_end + 3; /* the newline after "end" */
+                }
+                else if (*start) {
+                        reply_control(conn, run_command(start) ? "ok\n" : "error\n");
+                }
+                start = nl + 1;
+        }
 
-void update_window_type(Dael_Client* c)
-{
-        Atom type = XInternAtom(wm.dpy, "_NET_WM_WINDOW_TYPE", False);
-        Atom dialog = XInternAtom(wm.dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
-        Atom atom = get_window_atom_property(c, type);
-        c->is_floating = (atom == dialog);
+        /* keep the unfinished part for the next read */
+        conn->len = end - start;
+        memmove(conn->buf, start, conn->len);
 }
 
 
-void handle_event(XEvent* e)
+bool run_command(char* line)
 {
-        Dael_EventHandler* h;
-        for (h = event_handlers; h->handler; h++) {
-                if (e->type == h->event_type) {
-                        h->handler(e);
-                        return;
+        const Dael_Command* cmd;
+        char* arg;
+
+        if (wm.trace)
+                trace_command(line);
+        if ((arg = strchr(line, ' ')))
+                *arg++ = '\0';
+
+        for (cmd = commands; cmd->name; cmd++) {
+                if (!strcmp(cmd->name, line)) {
+                        cmd->func(arg);
+                        return true;
                 }
         }
+        return false;
 }
 
 
-void handle_property_notify(XEvent* e)
+/*
+ * "sync" does nothing. Commands and signals are handled in the order
+ * they arrive, so once its reply is read everything sent before it has
+ * been done, see daelbench.
+ */
+void sync_control(const char* args)
 {
-        Dael_Client* c;
-        XPropertyEvent* ev = &e->xproperty;
-        Atom type = XInternAtom(wm.dpy, "_NET_WM_WINDOW_TYPE", False);
+        (void) args;
+}
 
-        if ((c = get_client(ev->window))) {
-                if (ev->atom == type)
-                        update_window_type(c);
-        }
-        printf("propnotif\n");
+
+void reply_control(Dael_ControlConn* conn, const char* msg)
+{
+        /* a client that does not read its replies just loses them */
+        send(conn->fd, msg, strlen(msg), MSG_DONTWAIT | MSG_NOSIGNAL);
 }
 
 
-void handle_configure_request(XEvent* e)
+void drop_control(Dael_ControlConn* conn)
 {
-        (void) e;
-        /*
-        XConfigureRequestEvent *ev = &e->xconfigurerequest;
-        XWindowChanges wc;
-        Dael_Client* c = get_client(ev->window);
+        close(conn->fd);
+        conn->fd = -1;
+        conn->len = 0;
+}
 
-        if (!c || !c->is_floating)
-                return;
 
-        wc.x = ev->x;
-        wc.y = ev->y;
-        wc.width = ev->width;
-        wc.height = ev->height;
-        wc.border_width = ev->border_width;
-        wc.sibling = ev->above;
-        wc.stack_mode = ev->detail;
-        XConfigureWindow(wm.dpy, ev->window, ev->value_mask, &wc);
-        */
+void record_timing(Dael_Timing* t, const struct timespec* start, unsigned long first_request)
+{
+        struct timespec end;
+        unsigned long us;
+        unsigned int bucket = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        us = (end.tv_sec - start->tv_sec) * 1000000UL
+           + (end.tv_nsec - start->tv_nsec) / 1000;
+
+        while (bucket < HIST_BUCKETS - 1 && us >= (1UL << bucket))
+                bucket++;
+
+        t->count++;
+        t->total_us += us;
+        t->requests += wm.backend->next_request() - first_request;
+        t->hist[bucket]++;
 }
 
 
-void handle_key_press(XEvent* e)
+void reset_stats(void)
 {
-        unsigned int i = 0;
-        XKeyEvent k = e->xkey;
-        unsigned int modmask = CLEANMASK(k.state);
+        memset(&wm.stats, 0, sizeof(wm.stats));
+        wm.stats.request_base = wm.backend->next_request();
+        wm.stats.since = time(NULL);
+}
 
-        while (config_keys[i].key_sym != NoSymbol) {
-                if ((modmask == config_keys[i].mod)
-                && (k.keycode == XKeysymToKeycode(wm.dpy, config_keys[i].key_sym))
-                && (config_keys[i].func)) {
-                        config_keys[i].func(config_keys[i].arg);
 
-                }
-                i++;
+/*
+ * Written to a new file that then replaces the old one, so a reader never
+ * sees half a dump and a planted symlink is never followed.
+ */
+void dump_stats(void)
+{
+        char path[PATH_LEN];
+        char tmp[PATH_LEN + 4];
+        FILE* f;
+        int fd;
+
+        if (!runtime_path(path, sizeof(path), STATS_FILE))
+                return;
+        sprintf(tmp, "%s.new", path);
+        unlink(tmp);
+        if ((fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, S_IRUSR | S_IWUSR)) < 0
+        || !(f = fdopen(fd, "w"))) {
+                if (fd >= 0)
+                        close(fd);
+                perror(tmp);
+                return;
         }
+        print_stats(f);
+        if (fclose(f) || rename(tmp, path) < 0)
+                perror(path);
 }
 
 
-void handle_map_request(XEvent* e)
+/* one "key value..." record per line so the output is easy to parse */
+void print_stats(FILE* f)
 {
-        static XWindowAttributes wa;
-        XMapRequestEvent* req = &e->xmaprequest;
-        Dael_Client* client;
+        int i;
+
+        fprintf(f, "seconds %ld\n", (long) (time(NULL) - wm.stats.since));
+        fprintf(f, "requests %lu\n", wm.backend->next_request() - wm.stats.request_base);
+        fprintf(f, "round_trips %lu\n", wm.stats.round_trips);
+        fprintf(f, "flushes %lu\n", wm.stats.flushes);
+        fprintf(f, "wakeups %lu\n", wm.stats.wakeups);
+        fprintf(f, "configures_sent %lu\n", wm.stats.configures_sent);
+        fprintf(f, "configures_skipped %lu\n", wm.stats.configures_skipped);
+        fprintf(f, "configures_synthetic %lu\n", wm.stats.configures_synthetic);
+        fprintf(f, "key_repeats %lu\n", wm.stats.key_repeats);
+
+        for (i = 0; i < LASTEvent; i++)
+                print_timing(f, "event", event_names[i], &wm.stats.events[i]);
+        for (i = 0; i < MODE_COUNT; i++)
+                print_timing(f, "layout", mode_names[i], &wm.stats.layouts[i]);
+        print_timing(f, "launch", "spawn", &wm.stats.launches);
+        for (i = 0; i < wm.stats.program_count; i++) {
+                const Dael_Program* prog = &wm.stats.programs[i];
+                fprintf(f, "program %s launches %lu\n", prog->name, prog->launches);
+                print_timing(f, "map", prog->name, &prog->map_latency);
+        }
 
-	if (!XGetWindowAttributes(wm.dpy, req->window, &wa) || wa.override_redirect)
-		return;
+        fprintf(f, "clients %lu live %lu allocated %lu slabs\n",
+                wm.client_pool.in_use, wm.client_pool.allocs,
+                wm.client_pool.slab_count);
+        fprintf(f, "workspaces %lu live %lu allocated %lu slabs\n",
+                wm.workspace_pool.in_use, wm.workspace_pool.allocs,
+                wm.workspace_pool.slab_count);
+        fprintf(f, "rss_kb %ld\n", resident_kb());
+}
 
-        if (get_client(req->window))
-                return;
 
-        client = add_client(req->window);
-        XMapWindow(wm.dpy, req->window);
-        update_window_type(client);
+void print_timing(FILE* f, const char* kind, const char* name, const Dael_Timing* t)
+{
+        int i;
 
-        wm.current_workspace->focused = client;
-        set_window_focus(client);
+        if (!t->count)
+                return;
 
-        apply_layout();
+        fprintf(f, "%s %s count %lu total_us %lu requests %lu hist",
+                kind, name, t->count, t->total_us, t->requests);
+        for (i = 0; i < HIST_BUCKETS; i++)
+                fprintf(f, " %lu", t->hist[i]);
+        fputc('\n', f);
 }
 
 
-void handle_destroy_notify(XEvent* e)
+/* resident set size from /proc, -1 where that is not available */
+long resident_kb(void)
 {
-        Dael_Client* c;
-        XDestroyWindowEvent* ev = &e->xdestroywindow;
-        if ((c = get_client(ev->window))) {
-                Dael_Workspace* ws;
-                if ((ws = get_workspace_for_client(c))) {
-                        remove_client(ws, c);
-                }
-                apply_layout();
-        }
+        FILE* f = fopen("/proc/self/statm", "r");
+        long size;
+        long resident = -1;
+
+        if (!f)
+                return -1;
+        if (fscanf(f, "%ld %ld", &size, &resident) != 2)
+                resident = -1;
+        fclose(f);
+        return (resident < 0) ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
 }
 
 
@@ -890,14 +3816,6 @@ int xerror_handler(Display* display, XErrorEvent* error)
 }
 
 
-int xerror_ignore(Display* display, XErrorEvent* error)
-{
-        (void) display;
-        (void) error;
-        return 0;
-}
-
-
 void die(const char* e)
 {
         fprintf(stdout,"dael: %s\n",e);
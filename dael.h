@@ -0,0 +1,636 @@
+/*
+ * file: dael.h
+ * ------------
+ * Types and functions of dael shared by dael.c, layout.c, main.c and the
+ * tests in test.c. config.h goes after this header.
+ */
+#ifndef DAEL_H
+#define DAEL_H
+
+/* POSIX_SPAWN_SETSID, see launch_program */
+#define _GNU_SOURCE
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/XKBlib.h>
+#include <xcb/xcb.h>
+#ifdef XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "runtime.h"
+
+typedef enum {
+        NORMAL,
+        MONOCLE,
+
+        MODE_COUNT /* not a tiling mode, just designates size of enum */
+} Dael_TilingMode;
+
+/* atoms interned once at startup, see atom_names */
+typedef enum {
+        ATOM_WM_PROTOCOLS,
+        ATOM_WM_DELETE_WINDOW,
+        ATOM_WM_STATE,
+        ATOM_NET_WM_STATE,
+        ATOM_NET_WM_STATE_FULLSCREEN,
+        ATOM_NET_WM_STATE_HIDDEN,
+        ATOM_NET_WM_WINDOW_TYPE,
+        ATOM_NET_WM_WINDOW_TYPE_DIALOG,
+        ATOM_NET_WM_PID,
+        ATOM_NET_STARTUP_ID,
+        ATOM_NET_WM_PING,
+        ATOM_NET_SUPPORTED,
+        ATOM_NET_SUPPORTING_WM_CHECK,
+        ATOM_NET_WM_NAME,
+        ATOM_NET_CLIENT_LIST,
+        ATOM_NET_ACTIVE_WINDOW,
+        ATOM_NET_CURRENT_DESKTOP,
+        ATOM_NET_NUMBER_OF_DESKTOPS,
+        ATOM_UTF8_STRING,
+        ATOM_DAEL_STATE,
+
+        ATOM_COUNT /* not an atom, just designates size of enum */
+} Dael_Atom;
+
+/*
+ * The requests the window management logic makes, everything from the
+ * event handlers down goes through wm.backend instead of calling Xlib.
+ * Setup, key grabs, adoption, restarts and the control socket talk to
+ * Xlib directly, they only run against a real server.
+ * xlib_backend   the real thing
+ * fake_backend   does nothing but count, for daeltest, see test.c
+ */
+typedef struct {
+        void (*map)(Window win);
+        void (*unmap)(Window win);
+        void (*move)(Window win, int x, int y);
+        void (*move_resize)(Window win, int x, int y, unsigned int w, unsigned int h);
+        void (*configure)(Window win, unsigned int mask, XWindowChanges* wc);
+        void (*set_border_width)(Window win, unsigned int width);
+        void (*set_border_color)(Window win, unsigned long color);
+        void (*raise)(Window win);
+        void (*focus)(Window win);
+        void (*select_input)(Window win, long mask);
+        void (*change_property)(Window win, Atom prop, Atom type, int format, int mode,
+                                const unsigned char* data, int n);
+        void (*delete_property)(Window win, Atom prop);
+        int (*get_property)(Window win, Atom prop, long offset, long length, Bool del,
+                            Atom req_type, Atom* type, int* format, unsigned long* n,
+                            unsigned long* remaining, unsigned char** data);
+        void (*send_event)(Window win, long mask, XEvent* e);
+        void (*kill_client)(Window win);
+        void (*grab)(void);
+        void (*ungrab)(void);
+        int (*screen_width)(void);
+        int (*screen_height)(void);
+        unsigned long (*next_request)(void);
+} Dael_Backend;
+
+/* last geometry and border sent to the server for a client, -1 when
+ * nothing has been sent yet */
+typedef struct {
+        int x;
+        int y;
+        int w;
+        int h;
+        int border_width;
+        long border_color;
+} Dael_Geometry;
+
+/* geometry the layout functions compute for one client */
+typedef struct {
+        int x;
+        int y;
+        int w;
+        int h;
+        int border_width;
+} Dael_Rect;
+
+typedef struct Dael_Client Dael_Client;
+typedef struct Dael_Workspace Dael_Workspace;
+
+struct Dael_Client {
+        Window win;
+        bool is_fullscreen;
+        bool is_floating;
+        bool is_hidden;
+        bool is_hung;            /* did not answer the last _NET_WM_PING */
+        bool needs_map;          /* mapped by apply_layout once it is placed */
+        int ignore_unmap;        /* unmaps dael caused and should not act on */
+        bool ping_pending;       /* a _NET_WM_PING is waiting for its answer */
+        struct timespec ping_deadline;
+        int kill_stage;          /* how far kill_window has escalated */
+        bool kill_pending;       /* the current kill stage has a deadline */
+        struct timespec kill_deadline;
+        bool protocols_known;    /* false until WM_PROTOCOLS has been read */
+        unsigned long protocols; /* bit n set if atoms[n] is supported */
+        Dael_Geometry geom;
+        Dael_Rect float_geom;    /* asked for by a floating client, w 0 if never */
+        Dael_Workspace* ws;
+        Dael_Client* next;
+        Dael_Client* prev;
+        Dael_Client* hnext; /* next client in the same index bucket */
+};
+
+struct Dael_Workspace {
+        unsigned int id;
+        unsigned int master_size;
+        Dael_TilingMode mode;
+        int monitor;       /* index into wm.monitors, -1 when hidden */
+        bool needs_layout; /* laid out once the event queue is drained */
+        Dael_Client* clients;
+        Dael_Client* focused;
+        Dael_Workspace* next;
+        Dael_Workspace* prev;
+};
+
+typedef struct {
+        unsigned int mod;
+        KeySym key_sym;
+        void (*func)(const char*);
+        const void* arg;
+} Dael_Keybinding;
+
+/* an output and the workspace it shows */
+typedef struct {
+        Dael_Rect geom;
+        Dael_Workspace* ws;
+} Dael_Monitor;
+
+/* scratch arrays apply_layout fills and hands to the layout functions,
+ * they only ever grow */
+typedef struct {
+        Dael_Client** clients;
+        unsigned char* flags; /* LAYOUT_* flags of each client */
+        Dael_Rect* rects;
+        size_t capacity;
+} Dael_LayoutBuffer;
+
+/* fixed size object pool, items are carved out of slabs and recycled
+ * through a free list, slabs are only released by pool_destroy */
+typedef union Dael_Slab Dael_Slab;
+union Dael_Slab {
+        Dael_Slab* next;
+        /* only here so the items following the header are aligned */
+        long align_l;
+        double align_d;
+        void* align_p;
+};
+
+typedef struct {
+        size_t item_size;
+        size_t per_slab;
+        void* free_list;
+        Dael_Slab* slabs;
+        unsigned long slab_count;
+        unsigned long in_use;
+        unsigned long allocs; /* total number of pool_alloc calls */
+} Dael_Pool;
+
+/* hash index of every managed client, keyed by X window */
+typedef struct {
+        Dael_Client** buckets;
+        unsigned long size; /* always a power of two */
+        unsigned long count;
+} Dael_ClientIndex;
+
+/* number of latency histogram buckets, the last one holds everything
+ * slower than 2^(HIST_BUCKETS - 2) microseconds */
+#define HIST_BUCKETS 20
+
+/* call count, time and X requests spent on one kind of work, with a
+ * latency histogram where bucket n counts calls under 2^n microseconds */
+typedef struct {
+        unsigned long count;
+        unsigned long total_us;
+        unsigned long requests;
+        unsigned long hist[HIST_BUCKETS];
+} Dael_Timing;
+
+/* launches waiting for their windows, see find_launch */
+#define MAX_LAUNCHES 16
+#define MAX_PROGRAMS 32
+#define PROGRAM_NAME_LEN 32
+#define STARTUP_ID_LEN 48
+#define STARTUP_ENV "DESKTOP_STARTUP_ID="
+
+typedef struct {
+        pid_t pid;         /* 0 marks a free slot */
+        unsigned int ws_id;
+        bool mapped;       /* the time to map is taken for the first window */
+        struct timespec start;
+        char name[PROGRAM_NAME_LEN];
+        char startup_id[STARTUP_ID_LEN];
+} Dael_Launch;
+
+/* per program statistics, keyed by the basename of argv[0] */
+typedef struct {
+        char name[PROGRAM_NAME_LEN];
+        unsigned long launches;
+        Dael_Timing map_latency;
+} Dael_Program;
+
+typedef struct {
+        Dael_Timing events[LASTEvent];
+        Dael_Timing layouts[MODE_COUNT];
+        Dael_Timing launches;
+        Dael_Program programs[MAX_PROGRAMS];
+        int program_count;
+        unsigned long configures_sent;
+        unsigned long configures_skipped;
+        unsigned long configures_synthetic;
+        unsigned long round_trips;
+        unsigned long flushes;
+        unsigned long wakeups;     /* returns from poll in wait_for_input */
+        unsigned long key_repeats; /* autorepeats folded into a later layout */
+        unsigned long request_base; /* NextRequest() at the last reset */
+        time_t since;
+} Dael_Stats;
+
+/* limits of a launch_program command line */
+#define LAUNCH_MAX_LEN 1024
+#define LAUNCH_MAX_ARGS 64
+
+/*
+ * An event trace is a Dael_TraceHeader followed by Dael_TraceRecords in
+ * the order the events were handled. A record of type TRACE_BATCH_END
+ * marks where the main loop laid out and flushed. A TRACE_COMMAND record
+ * is a control command, its text follows the record and event.xany.serial
+ * holds the length. Traces are only read back by a dael built for the
+ * same architecture.
+ */
+#define TRACE_MAGIC "DAELTRC2"
+#define TRACE_BUFSIZE 65536
+#define TRACE_BUFMAX (16 * 1024 * 1024)
+#define TRACE_BATCH_END 0
+#define TRACE_COMMAND 1
+
+typedef struct {
+        char magic[8];
+        unsigned long event_size; /* sizeof(XEvent) when it was recorded */
+        unsigned long root;
+        unsigned long atoms[ATOM_COUNT];
+} Dael_TraceHeader;
+
+typedef struct {
+        long sec;  /* CLOCK_MONOTONIC when the event was handled */
+        long nsec;
+        XEvent event;
+} Dael_TraceRecord;
+
+/* records are collected here and handed to the writer process at the end
+ * of each event batch, see open_trace */
+typedef struct {
+        int fd;            /* dael's end of the socket to the writer */
+        pid_t writer;
+        const char* path;  /* reopened if a restart fails */
+        bool pending;      /* records since the last TRACE_BATCH_END */
+        size_t len;
+        size_t size;
+        char* buf;
+} Dael_Trace;
+
+/* recorded window ids and the stand-in windows created for them */
+typedef struct {
+        Window* from;
+        Window* to;
+        size_t count;
+        size_t capacity;
+        Window root;
+        const unsigned long* atoms;
+} Dael_ReplayMap;
+
+/* deferred work scheduled with add_timer */
+#define MAX_TIMERS 32
+
+typedef struct {
+        struct timespec when;
+        void (*func)(void* arg);
+        void* arg;
+        bool active;
+} Dael_Timer;
+
+/* outputs beyond this are ignored */
+#define MAX_MONITORS 8
+
+/* control socket limits, a whole begin/end block has to fit in the
+ * buffer of its connection */
+#define CONTROL_MAX_CONNS 8
+#define CONTROL_BUFSIZE 16384
+
+/* a client of the control socket, buf holds input not yet executed */
+typedef struct {
+        int fd; /* -1 when the slot is free */
+        size_t len;
+        char buf[CONTROL_BUFSIZE];
+} Dael_ControlConn;
+
+typedef struct {
+        Dael_Workspace* workspaces;
+        Dael_Workspace* current_workspace;
+        Dael_ClientIndex index;
+        Dael_LayoutBuffer layout;
+        Dael_Monitor monitors[MAX_MONITORS];
+        int monitor_count;
+        int selected_monitor; /* the one showing current_workspace */
+        int screen_change_event; /* RandR event type, -1 without RandR */
+        unsigned int held_key;   /* keycode of the binding being held, 0 if none */
+        bool layout_throttled;   /* a resize key repeats, see layout_delay */
+        int layout_timer;        /* wakes the loop for a held back layout */
+        int client_timer;        /* earliest ping or kill deadline, see client_timeout */
+        struct timespec last_layout;
+        Dael_Timer timers[MAX_TIMERS];
+        Dael_Launch launches[MAX_LAUNCHES];
+        unsigned long launch_seq;
+        unsigned int last_workspace_id; /* ids are never handed out twice */
+        int timer_fd;
+        int signal_fd;
+        Dael_Pool client_pool;
+        Dael_Pool workspace_pool;
+        Atom atoms[ATOM_COUNT];
+        Dael_Stats stats;
+        int control_fd;
+        Dael_ControlConn control[CONTROL_MAX_CONNS];
+        char control_path[PATH_LEN];
+        dev_t control_dev;      /* the socket file bind created */
+        ino_t control_ino;
+        bool in_block;          /* running a control block, see show_workspace */
+        Window root;
+        Window check_win;       /* for _NET_SUPPORTING_WM_CHECK */
+        Window active_win;      /* last _NET_ACTIVE_WINDOW written */
+        long current_desktop;   /* last _NET_CURRENT_DESKTOP written */
+        long desktop_count;     /* last _NET_NUMBER_OF_DESKTOPS written */
+        Display* dpy;           /* NULL with the fake backend */
+        const Dael_Backend* backend;
+        Dael_Trace* trace;      /* NULL unless started with -t */
+        bool replaying;         /* started with -r, see replay_trace */
+        bool running;
+} Dael_State;
+
+typedef struct {
+        int event_type;
+        void (*handler)(XEvent*);
+} Dael_EventHandler;
+
+typedef struct {
+        const char* name;
+        void (*func)(const char*);
+} Dael_Command;
+
+/* handy macro from dwm */
+#define CLEANMASK(mask) (mask & ~(numlockmask | LockMask))
+
+#define INDEX_INITIAL_SIZE 64
+
+/* actions of a _NET_WM_STATE client message */
+#define NET_WM_STATE_REMOVE 0
+#define NET_WM_STATE_ADD 1
+#define NET_WM_STATE_TOGGLE 2
+
+/* input flags of the layout functions */
+#define LAYOUT_FLOATING (1 << 0)
+
+/* size of floating (dialog) windows */
+#define FLOAT_WIDTH 640
+#define FLOAT_HEIGHT 480
+
+/* pool items per slab */
+#define CLIENTS_PER_SLAB 64
+#define WORKSPACES_PER_SLAB 16
+
+/* layout of the _DAEL_STATE root property written by restart(), every
+ * field is one 32 bit item:
+ *   header:    version, workspace count, index of current workspace
+ *   workspace: id, master_size, mode, client count, focused index + 1,
+ *              monitor (-1 when hidden)
+ *   client:    window, flags, x, y, w, h, border width, border colour,
+ *              float x, y, w, h (w 0 if it never asked for a size) */
+#define STATE_VERSION 3
+#define STATE_HEADER_LEN 3
+#define STATE_WORKSPACE_LEN 6
+#define STATE_CLIENT_LEN 12
+#define STATE_FLOATING (1 << 0)
+#define STATE_FULLSCREEN (1 << 1)
+
+/* dimensions of the key dispatch table: every keycode by every
+ * modifier combination of the core modifier bits */
+#define KEYCODE_COUNT 256
+#define KEYMASK_COUNT 256
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* config.h / user key-bindable functions */
+void launch_program(const char* program);
+void quit(const char* args);
+void swap_master(const char* args);
+void focus_next(const char* args);
+void focus_prev(const char* args);
+void increase_size(const char* args);
+void decrease_size(const char* args);
+void append_workspace(const char* args);
+void next_workspace(const char* args);
+void prev_workspace(const char* args);
+void cycle_tiling_mode(const char* args);
+void next_monitor(const char* args);
+void kill_window(const char* args);
+void restart(const char* args);
+
+void update_numlockmask(void);
+void open_trace(const char* path);
+void trace_writer(int in, int out);
+bool trace_room(size_t size);
+void trace_event(const XEvent* e, int type);
+void trace_command(const char* line);
+void flush_trace(void);
+void close_trace(void);
+void stop_trace(bool wait);
+int replay_trace(const char* path, bool paced);
+void translate_event(Dael_ReplayMap* map, XEvent* e);
+Window translate_window(Dael_ReplayMap* map, Window win, bool create);
+Atom translate_atom(Dael_ReplayMap* map, Atom atom);
+void setup_keys(void);
+void build_key_table(void);
+Dael_Client* add_client(Window win);
+Dael_Client* attach_client(Dael_Workspace* ws, Window win);
+Dael_Workspace* alloc_workspace(unsigned int id);
+void reclaim_workspaces(void);
+void pool_init(Dael_Pool* pool, size_t item_size, size_t per_slab);
+void* pool_alloc(Dael_Pool* pool);
+void pool_free(Dael_Pool* pool, void* item);
+void pool_destroy(Dael_Pool* pool);
+void print_stats(FILE* f);
+void print_timing(FILE* f, const char* kind, const char* name, const Dael_Timing* t);
+void record_timing(Dael_Timing* t, const struct timespec* start, unsigned long first_request);
+void reset_stats(void);
+void dump_stats(void);
+void wait_for_input(void);
+void setup_signals(void);
+int split_args(char* line, char** argv, int max);
+Dael_Launch* record_launch(pid_t pid, const char* program, const char* startup_id,
+                           const struct timespec* start);
+Dael_Launch* find_launch(Window win);
+void expire_launches(void);
+bool launch_pending(unsigned int ws_id);
+Dael_Program* program_stats(const char* name);
+Dael_Workspace* find_workspace(unsigned int id);
+Dael_Workspace* place_client(Window win);
+void read_signals(void);
+int add_timer(long ms, void (*func)(void* arg), void* arg);
+int add_timer_at(const struct timespec* when, void (*func)(void* arg), void* arg);
+void cancel_timer(int id);
+void time_after(struct timespec* t, long ms);
+void run_timers(void);
+void arm_timer_fd(void);
+int compare_time(const struct timespec* a, const struct timespec* b);
+int layout_delay(void);
+void layout_timeout(void* arg);
+bool coalesces_repeats(void (*func)(const char*));
+void setup_control(void);
+void close_control(void);
+void accept_control(void);
+void read_control(Dael_ControlConn* conn);
+void process_control(Dael_ControlConn* conn, bool eof);
+bool run_command(char* line);
+void sync_control(const char* args);
+void reply_control(Dael_ControlConn* conn, const char* msg);
+void drop_control(Dael_ControlConn* conn);
+bool socket_in_use(const struct sockaddr_un* addr);
+long resident_kb(void);
+void remove_client(Dael_Workspace* ws, Dael_Client* c);
+void move_client_before(Dael_Workspace* ws, Dael_Client* c, Dael_Client* before);
+Dael_Client* get_client(Window win);
+unsigned long index_hash(Window win, unsigned long size);
+void index_insert(Dael_Client* c);
+void index_remove(Dael_Client* c);
+void index_grow(void);
+void switch_workspace(Dael_Workspace* ws);
+void update_monitors(void);
+int query_outputs(Dael_Rect* out, int max);
+void show_on_monitor(Dael_Workspace* ws, int m);
+Dael_Workspace* unused_workspace(void);
+void handle_screen_change(XEvent* e);
+void hide_workspace(Dael_Workspace* ws);
+void show_workspace(Dael_Workspace* ws);
+void set_client_state(Dael_Client* c, long state);
+Dael_Workspace* get_workspace_for_client(Dael_Client* client);
+
+void change_master_size(int amount);
+void request_layout(Dael_Workspace* ws);
+void apply_pending_layout(void);
+void apply_layout(Dael_Workspace* ws);
+void grow_layout_buffer(Dael_LayoutBuffer* buf);
+void layout_normal(const unsigned char* flags, size_t n, int w, int h,
+                   int master_size, Dael_Rect* out);
+void layout_monocle(const unsigned char* flags, size_t n, int w, int h, Dael_Rect* out);
+void layout_floating(const unsigned char* flags, size_t n, int w, int h, Dael_Rect* out);
+void set_rect(Dael_Rect* r, int x, int y, int w, int h, int border_width);
+void grab_keys(void);
+int send_event(Dael_Client* c, Dael_Atom proto);
+void update_protocols(Dael_Client* c);
+unsigned long protocol_mask(const Atom* protocols, int n);
+void adopt_existing_windows(void);
+void save_state(void);
+bool restore_state(void);
+void restore_workspaces(const long* data, unsigned long len);
+int compare_windows(const void* a, const void* b);
+void adopt_windows(xcb_connection_t* conn, const Window* wins, unsigned int n);
+Atom get_window_atom_property(Dael_Client* c, Atom prop);
+void set_window_focus(Dael_Client* client);
+void focus_root(void);
+void setup_ewmh(void);
+void update_client_list(void);
+void update_active_window(Window win);
+void update_desktops(void);
+void update_window_type(Dael_Client* c);
+void set_window_border(Dael_Client* client);
+void ping_client(Dael_Client* c);
+void schedule_client_timer(const struct timespec* when);
+void client_timeout(void* arg);
+void escalate_kill(Dael_Client* c);
+pid_t get_window_pid(Dael_Client* c);
+bool is_local_client(Dael_Client* c);
+void handle_client_message(XEvent* e);
+void set_fullscreen(Dael_Client* c, bool fullscreen);
+void activate_client(Dael_Client* c);
+void switch_to_desktop(long n);
+bool is_tiled(const Dael_Client* c);
+void set_border_width(Dael_Client* c, int width);
+void move_resize_client(Dael_Client* c, int x, int y, int w, int h);
+void remove_window_border(Dael_Client* client);
+void setup_event_handlers(void);
+void handle_event(XEvent* e);
+void handle_property_notify(XEvent* e);
+void handle_configure_request(XEvent *e);
+void send_configure_notify(Dael_Client* c);
+void send_synthetic_configure(Window win, int x, int y, int w, int h, int border_width);
+void handle_key_press(XEvent* e);
+void handle_key_release(XEvent* e);
+void handle_map_request(XEvent* e);
+void handle_destroy_notify(XEvent* e);
+void handle_mapping_notify(XEvent* e);
+void handle_unmap_notify(XEvent* e);
+
+void Dael_State_init(Dael_State* state);
+void init_state(Dael_State* state);
+void Dael_State_free(Dael_State* state);
+
+void xlib_map(Window win);
+void xlib_unmap(Window win);
+void xlib_move(Window win, int x, int y);
+void xlib_move_resize(Window win, int x, int y, unsigned int w, unsigned int h);
+void xlib_configure(Window win, unsigned int mask, XWindowChanges* wc);
+void xlib_set_border_width(Window win, unsigned int width);
+void xlib_set_border_color(Window win, unsigned long color);
+void xlib_raise(Window win);
+void xlib_focus(Window win);
+void xlib_select_input(Window win, long mask);
+void xlib_change_property(Window win, Atom prop, Atom type, int format, int mode,
+                          const unsigned char* data, int n);
+void xlib_delete_property(Window win, Atom prop);
+int xlib_get_property(Window win, Atom prop, long offset, long length, Bool del,
+                      Atom req_type, Atom* type, int* format, unsigned long* n,
+                      unsigned long* remaining, unsigned char** data);
+void xlib_send_event(Window win, long mask, XEvent* e);
+void xlib_kill_client(Window win);
+void xlib_grab(void);
+void xlib_ungrab(void);
+int xlib_screen_width(void);
+int xlib_screen_height(void);
+unsigned long xlib_next_request(void);
+
+int xerror_handler(Display* display, XErrorEvent* error);
+void die(const char* e);
+
+/* defined in dael.c */
+extern Dael_State wm;
+extern void (*handler_table[LASTEvent])(XEvent*);
+extern const char* mode_names[MODE_COUNT];
+extern unsigned int numlockmask;
+extern unsigned short key_table[KEYCODE_COUNT][KEYMASK_COUNT];
+extern const Dael_Keybinding* key_bindings;
+extern char** dael_argv;
+
+/* main.c and test.c each have their own */
+void usage(void);
+
+#endif
@@ -0,0 +1,580 @@
+/*
+ * file: daelbench.c
+ * -----------------
+ * Drives scripted scenarios against a running dael and reports how long
+ * each operation took to take effect, see bench.sh and `make bench`.
+ *
+ * usage: daelbench -p pid [-n windows] [-r rounds]
+ *        daelbench -a dael [-n windows]
+ *
+ * Windows are mapped and destroyed as a plain X client, everything else
+ * goes through the control socket. An operation counts as done once its
+ * effect shows up on the display:
+ *   map        MapNotify of the new window, dael maps after the layout
+ *   destroy    _NET_CLIENT_LIST changing on the root window
+ *   focus      _NET_ACTIVE_WINDOW changing
+ *   workspace  _NET_CURRENT_DESKTOP changing
+ *   resize and monocle   a ConfigureNotify on one of the windows
+ *   adopt      all windows in _NET_CLIENT_LIST, see bench_adopt
+ *
+ * For every scenario one line of "key value" pairs is printed, with the
+ * latency percentiles, the X requests dael made per operation (from its
+ * statistics), the ConfigureNotify and Expose events the bench windows
+ * got per operation and the CPU time dael used.
+ */
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "runtime.h"
+
+#define LINE_LEN 256
+#define OP_TIMEOUT 1000      /* ms an operation may take before it counts as lost */
+#define ADOPT_TIMEOUT 10000  /* ms dael may take to start and adopt every window */
+#define DEFAULT_WINDOWS 20
+#define DEFAULT_ROUNDS 100
+
+typedef struct {
+        const char* name;
+        long* us;            /* latency of each operation */
+        int ops;
+        int timeouts;
+        unsigned long requests;
+        unsigned long configures; /* ConfigureNotify on the bench windows */
+        unsigned long exposes;    /* the last Expose of each series, a repaint */
+        long cpu_ms;
+} Bench_Result;
+
+typedef struct {
+        Display* dpy;
+        Window root;
+        Window* wins;
+        int win_count;
+        Atom client_list;
+        Atom active_window;
+        Atom current_desktop;
+        pid_t dael;
+        const char* adopt;   /* the dael to start for bench_adopt */
+        int control_fd;
+        char stats_path[PATH_LEN];
+        FILE* control;
+        Bench_Result result;
+        long cpu_start;
+        int rounds;
+} Bench_State;
+
+int connect_control(const char* path);
+int command(const char* cmd);
+void sync_dael(void);
+long now_us(void);
+long cpu_ms(pid_t pid);
+void begin_scenario(const char* name);
+void end_scenario(void);
+void record_op(long start, int ok);
+int wait_event(int type, Window win, Atom atom);
+int is_bench_window(Window win);
+void count_event(const XEvent* e);
+void drain_events(void);
+int compare_long(const void* a, const void* b);
+void bench_map(void);
+void bench_focus(void);
+void bench_resize(void);
+void bench_monocle(void);
+void bench_workspace(void);
+void bench_destroy(void);
+int bench_adopt(void);
+int client_count(void);
+void usage(void);
+
+Bench_State bench;
+
+
+int main(int argc, char* argv[])
+{
+        char socket_path[PATH_LEN];
+        struct timespec retry;
+        int i;
+
+        retry.tv_sec = 0;
+        retry.tv_nsec = 100000000L;
+
+        bench.win_count = DEFAULT_WINDOWS;
+        bench.rounds = DEFAULT_ROUNDS;
+        for (i = 1; i + 1 < argc; i += 2) {
+                if (!strcmp(argv[i], "-p"))
+                        bench.dael = atoi(argv[i + 1]);
+                else if (!strcmp(argv[i], "-a"))
+                        bench.adopt = argv[i + 1];
+                else if (!strcmp(argv[i], "-n"))
+                        bench.win_count = atoi(argv[i + 1]);
+                else if (!strcmp(argv[i], "-r"))
+                        bench.rounds = atoi(argv[i + 1]);
+                else
+                        usage();
+        }
+        if (i != argc || (bench.dael <= 0) == !bench.adopt || bench.win_count < 2
+        || bench.rounds < 1)
+                usage();
+
+        if (!(bench.dpy = XOpenDisplay(NULL))) {
+                fprintf(stderr, "daelbench: failed to open display\n");
+                return 1;
+        }
+        bench.root = DefaultRootWindow(bench.dpy);
+        bench.client_list = XInternAtom(bench.dpy, "_NET_CLIENT_LIST", False);
+        bench.active_window = XInternAtom(bench.dpy, "_NET_ACTIVE_WINDOW", False);
+        bench.current_desktop = XInternAtom(bench.dpy, "_NET_CURRENT_DESKTOP", False);
+        XSelectInput(bench.dpy, bench.root, PropertyChangeMask);
+
+        bench.wins = calloc(bench.win_count, sizeof(Window));
+        bench.result.us = malloc(sizeof(long) * (bench.rounds > bench.win_count
+                                                 ? bench.rounds : bench.win_count));
+        if (!bench.wins || !bench.result.us) {
+                fprintf(stderr, "daelbench: out of memory\n");
+                return 1;
+        }
+        if (bench.adopt) {
+                i = bench_adopt();
+                XCloseDisplay(bench.dpy);
+                return i;
+        }
+
+        if (!runtime_path(socket_path, sizeof(socket_path), ".sock")
+        || !runtime_path(bench.stats_path, sizeof(bench.stats_path), ".stats"))
+                return 1;
+
+        /* dael may still be starting up */
+        for (i = 0; i < 50 && (bench.control_fd = connect_control(socket_path)) < 0; i++)
+                nanosleep(&retry, NULL);
+        if (bench.control_fd < 0 || !(bench.control = fdopen(bench.control_fd, "r"))) {
+                perror(socket_path);
+                return 1;
+        }
+
+        bench_map();
+        bench_focus();
+        bench_resize();
+        bench_monocle();
+        bench_workspace();
+        bench_destroy();
+
+        fclose(bench.control);
+        XCloseDisplay(bench.dpy);
+        return 0;
+}
+
+
+int connect_control(const char* path)
+{
+        struct sockaddr_un addr;
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (fd < 0)
+                return -1;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+        if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+                close(fd);
+                return -1;
+        }
+        return fd;
+}
+
+
+/* runs cmd and waits for dael's reply, returns 0 if it failed */
+int command(const char* cmd)
+{
+        char line[LINE_LEN];
+        size_t len = strlen(cmd);
+
+        if (write(bench.control_fd, cmd, len) != (ssize_t) len
+        || write(bench.control_fd, "\n", 1) != 1
+        || !fgets(line, sizeof(line), bench.control)) {
+                fprintf(stderr, "daelbench: lost the control socket\n");
+                exit(1);
+        }
+        return !strncmp(line, "ok", 2);
+}
+
+
+/* a no-op round trip through the control socket, anything sent to dael
+ * before it has been handled once it returns */
+void sync_dael(void)
+{
+        if (!command("sync")) {
+                fprintf(stderr, "daelbench: dael did not take the sync command\n");
+                exit(1);
+        }
+}
+
+
+long now_us(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+
+/* user and system time of pid from /proc, -1 if unknown */
+long cpu_ms(pid_t pid)
+{
+        char path[64];
+        char buf[1024];
+        unsigned long utime;
+        unsigned long stime;
+        char* p;
+        FILE* f;
+        size_t n;
+
+        sprintf(path, "/proc/%ld/stat", (long) pid);
+        if (!(f = fopen(path, "r")))
+                return -1;
+        n = fread(buf, 1, sizeof(buf) - 1, f);
+        fclose(f);
+        buf[n] = '\0';
+
+        /* the name in parentheses may contain spaces, skip past it to
+         * the state and count the fields from there */
+        if (!(p = strrchr(buf, ')'))
+        || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                  &utime, &stime) != 2)
+                return -1;
+        return (long) ((utime + stime) * 1000 / sysconf(_SC_CLK_TCK));
+}
+
+
+/*
+ * Signals are read before the control socket in the same wakeup of dael,
+ * so once a command sent after the signal has been answered the signal
+ * has been handled.
+ */
+void begin_scenario(const char* name)
+{
+        drain_events();
+        kill(bench.dael, SIGUSR2);
+        sync_dael();
+
+        bench.result.name = name;
+        bench.result.ops = 0;
+        bench.result.timeouts = 0;
+        bench.result.configures = 0;
+        bench.result.exposes = 0;
+        bench.cpu_start = cpu_ms(bench.dael);
+}
+
+
+void end_scenario(void)
+{
+        Bench_Result* r = &bench.result;
+        char line[LINE_LEN];
+        long cpu = cpu_ms(bench.dael);
+        FILE* f;
+        int n = r->ops;
+
+        unlink(bench.stats_path);
+        kill(bench.dael, SIGUSR1);
+        sync_dael();
+        drain_events();
+
+        r->requests = 0;
+        if ((f = fopen(bench.stats_path, "r"))) {
+                while (fgets(line, sizeof(line), f))
+                        if (sscanf(line, "requests %lu", &r->requests) == 1)
+                                break;
+                fclose(f);
+        }
+        r->cpu_ms = (cpu >= 0 && bench.cpu_start >= 0) ? cpu - bench.cpu_start : -1;
+
+        qsort(r->us, n, sizeof(long), compare_long);
+        printf("scenario %s ops %d timeouts %d p50_us %ld p90_us %ld p99_us %ld max_us %ld"
+               " requests_per_op %.1f configures_per_op %.1f exposes_per_op %.1f"
+               " cpu_ms %ld\n",
+               r->name, n, r->timeouts,
+               n ? r->us[n / 2] : 0L,
+               n ? r->us[n * 9 / 10] : 0L,
+               n ? r->us[n * 99 / 100] : 0L,
+               n ? r->us[n - 1] : 0L,
+               n ? (double) r->requests / n : 0.0,
+               n ? (double) r->configures / n : 0.0,
+               n ? (double) r->exposes / n : 0.0,
+               r->cpu_ms);
+        fflush(stdout);
+}
+
+
+/* lost operations are counted but left out of the percentiles */
+void record_op(long start, int ok)
+{
+        if (ok)
+                bench.result.us[bench.result.ops++] = now_us() - start;
+        else
+                bench.result.timeouts++;
+        drain_events();
+}
+
+
+/*
+ * Waits up to OP_TIMEOUT for an event of type, on win (any of the bench
+ * windows if None) or for PropertyNotify of atom on the root window.
+ * Returns 0 on timeout.
+ */
+int wait_event(int type, Window win, Atom atom)
+{
+        long deadline = now_us() + OP_TIMEOUT * 1000L;
+        struct pollfd pfd;
+        XEvent e;
+
+        pfd.fd = ConnectionNumber(bench.dpy);
+        pfd.events = POLLIN;
+
+        for (;;) {
+                while (XPending(bench.dpy)) {
+                        XNextEvent(bench.dpy, &e);
+                        count_event(&e);
+                        if (e.type != type)
+                                continue;
+                        if (type == PropertyNotify) {
+                                if (e.xproperty.window == bench.root && e.xproperty.atom == atom)
+                                        return 1;
+                        }
+                        else if (win ? e.xany.window == win : is_bench_window(e.xany.window)) {
+                                return 1;
+                        }
+                }
+                if (now_us() >= deadline)
+                        return 0;
+                if (poll(&pfd, 1, (int) ((deadline - now_us()) / 1000) + 1) < 0 && errno != EINTR)
+                        return 0;
+        }
+}
+
+
+int is_bench_window(Window win)
+{
+        int i;
+
+        for (i = 0; i < bench.win_count; i++)
+                if (bench.wins[i] == win)
+                        return 1;
+        return 0;
+}
+
+
+void count_event(const XEvent* e)
+{
+        if (e->type == ConfigureNotify && is_bench_window(e->xconfigure.window))
+                bench.result.configures++;
+        else if (e->type == Expose && !e->xexpose.count && is_bench_window(e->xexpose.window))
+                bench.result.exposes++;
+}
+
+
+/* everything dael did for the last operation has arrived once the sync
+ * returns, none of it may be mistaken for the next one but it still
+ * counts for this one */
+void drain_events(void)
+{
+        XEvent e;
+
+        XSync(bench.dpy, False);
+        while (XPending(bench.dpy)) {
+                XNextEvent(bench.dpy, &e);
+                count_event(&e);
+        }
+}
+
+
+int compare_long(const void* a, const void* b)
+{
+        long x = *(const long*) a;
+        long y = *(const long*) b;
+        return (x > y) - (x < y);
+}
+
+
+void bench_map(void)
+{
+        long start;
+        int i;
+
+        begin_scenario("map");
+        for (i = 0; i < bench.win_count; i++) {
+                bench.wins[i] = XCreateSimpleWindow(bench.dpy, bench.root, 0, 0, 100, 100,
+                                                    0, 0, 0);
+                XSelectInput(bench.dpy, bench.wins[i], StructureNotifyMask | ExposureMask);
+                start = now_us();
+                XMapWindow(bench.dpy, bench.wins[i]);
+                XFlush(bench.dpy);
+                record_op(start, wait_event(MapNotify, bench.wins[i], None));
+        }
+        end_scenario();
+}
+
+
+void bench_focus(void)
+{
+        long start;
+        int i;
+
+        begin_scenario("focus");
+        for (i = 0; i < bench.rounds; i++) {
+                start = now_us();
+                record_op(start, command("focus_next")
+                                 && wait_event(PropertyNotify, None, bench.active_window));
+        }
+        end_scenario();
+}
+
+
+/* increase then decrease, so the master never hits MASTER_MAX or
+ * MASTER_MIN and every step changes the layout */
+void bench_resize(void)
+{
+        long start;
+        int i;
+
+        begin_scenario("resize");
+        for (i = 0; i < bench.rounds; i++) {
+                start = now_us();
+                record_op(start, command(i % 2 ? "decrease_size" : "increase_size")
+                                 && wait_event(ConfigureNotify, None, None));
+        }
+        end_scenario();
+}
+
+
+void bench_monocle(void)
+{
+        long start;
+        int i;
+
+        begin_scenario("monocle");
+        for (i = 0; i < bench.rounds; i++) {
+                start = now_us();
+                record_op(start, command("cycle_tiling_mode")
+                                 && wait_event(ConfigureNotify, None, None));
+        }
+        /* back to the tiling mode the other scenarios expect */
+        if (bench.rounds % 2)
+                command("cycle_tiling_mode");
+        end_scenario();
+}
+
+
+/* to a new, empty workspace and back, which reclaims it again */
+void bench_workspace(void)
+{
+        long start;
+        int i;
+
+        begin_scenario("workspace");
+        for (i = 0; i < bench.rounds; i++) {
+                start = now_us();
+                record_op(start, command(i % 2 ? "prev_workspace" : "append_workspace")
+                                 && wait_event(PropertyNotify, None, bench.current_desktop));
+        }
+        if (bench.rounds % 2)
+                command("prev_workspace");
+        end_scenario();
+}
+
+
+void bench_destroy(void)
+{
+        long start;
+        int i;
+
+        begin_scenario("destroy");
+        for (i = 0; i < bench.win_count; i++) {
+                start = now_us();
+                XDestroyWindow(bench.dpy, bench.wins[i]);
+                XFlush(bench.dpy);
+                record_op(start, wait_event(PropertyNotify, None, bench.client_list));
+        }
+        end_scenario();
+}
+
+
+/*
+ * Maps the windows with no window manager running, then starts dael and
+ * times until all of them are in _NET_CLIENT_LIST, from the fork to the
+ * last one adopted, which includes dael connecting and setting up. dael
+ * is stopped again afterwards.
+ */
+int bench_adopt(void)
+{
+        long start;
+        long deadline;
+        pid_t pid;
+        int adopted = 0;
+        int i;
+
+        for (i = 0; i < bench.win_count; i++) {
+                bench.wins[i] = XCreateSimpleWindow(bench.dpy, bench.root, 0, 0, 100, 100,
+                                                    0, 0, 0);
+                XMapWindow(bench.dpy, bench.wins[i]);
+        }
+        XSync(bench.dpy, False);
+
+        start = now_us();
+        if ((pid = fork()) < 0) {
+                perror("fork");
+                return 1;
+        }
+        if (!pid) {
+                execl(bench.adopt, bench.adopt, (char*) NULL);
+                perror(bench.adopt);
+                _exit(127);
+        }
+
+        deadline = start + ADOPT_TIMEOUT * 1000L;
+        while (adopted < bench.win_count && now_us() < deadline)
+                if (wait_event(PropertyNotify, None, bench.client_list))
+                        adopted = client_count();
+        printf("scenario adopt windows %d adopted %d us %ld\n", bench.win_count, adopted,
+               now_us() - start);
+        fflush(stdout);
+
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        return adopted != bench.win_count;
+}
+
+
+int client_count(void)
+{
+        Atom type;
+        int format;
+        unsigned long n;
+        unsigned long after;
+        unsigned char* data = NULL;
+
+        if (XGetWindowProperty(bench.dpy, bench.root, bench.client_list, 0, bench.win_count,
+                               False, XA_WINDOW, &type, &format, &n, &after, &data) != Success)
+                return 0;
+        XFree(data);
+        return (int) n;
+}
+
+
+void usage(void)
+{
+        fprintf(stderr, "usage: daelbench -p pid [-n windows] [-r rounds]\n"
+                        "       daelbench -a dael [-n windows]\n");
+        exit(1);
+}
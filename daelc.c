@@ -0,0 +1,164 @@
+/*
+ * file: daelc.c
+ * -------------
+ * Sends commands to a running dael over its control socket.
+ *
+ * usage: daelc [-s socket] function [argument]
+ *        daelc [-s socket] -
+ *
+ * With '-' the commands are read from stdin, one per line. Lines between
+ * "begin" and "end" are run by dael as one block with a single layout.
+ *
+ * The default socket is the one of the dael on $DISPLAY, see
+ * runtime_path.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "runtime.h"
+
+#define LINE_LEN 64
+
+int connect_socket(const char* path);
+int send_all(int fd, const char* buf, size_t len);
+int send_stdin(int fd);
+int print_replies(int fd);
+void usage(void);
+
+
+int main(int argc, char* argv[])
+{
+        char default_path[PATH_LEN];
+        const char* path = default_path;
+        int fd;
+        int i = 1;
+        int ok;
+
+        if (argc > 2 && !strcmp(argv[1], "-s")) {
+                path = argv[2];
+                i = 3;
+        }
+        else if (!runtime_path(default_path, sizeof(default_path), ".sock")) {
+                return 1;
+        }
+        if (i >= argc || argc - i > 2)
+                usage();
+
+        if ((fd = connect_socket(path)) < 0) {
+                perror(path);
+                return 1;
+        }
+
+        if (!strcmp(argv[i], "-")) {
+                ok = send_stdin(fd);
+        }
+        else {
+                ok = send_all(fd, argv[i], strlen(argv[i]));
+                if (ok && i + 1 < argc)
+                        ok = send_all(fd, " ", 1)
+                          && send_all(fd, argv[i + 1], strlen(argv[i + 1]));
+                ok = ok && send_all(fd, "\n", 1);
+        }
+
+        /* dael replies to everything it got once it sees the end */
+        shutdown(fd, SHUT_WR);
+        if (!ok) {
+                perror("send");
+                return 1;
+        }
+
+        ok = print_replies(fd);
+        close(fd);
+        return ok ? 0 : 1;
+}
+
+
+int connect_socket(const char* path)
+{
+        struct sockaddr_un addr;
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (fd < 0)
+                return -1;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+        if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+                close(fd);
+                return -1;
+        }
+        return fd;
+}
+
+
+int send_all(int fd, const char* buf, size_t len)
+{
+        while (len) {
+                ssize_t n = write(fd, buf, len);
+                if (n <= 0)
+                        return 0;
+                buf += n;
+                len -= n;
+        }
+        return 1;
+}
+
+
+int send_stdin(int fd)
+{
+        char buf[4096];
+        size_t n;
+
+        while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0)
+                if (!send_all(fd, buf, n))
+                        return 0;
+        return 1;
+}
+
+
+/*
+ * Copies the replies to stdout, returns 0 if any of them is an error or
+ * a block with failed commands ("ok N failed M" with M > 0).
+ */
+int print_replies(int fd)
+{
+        char buf[4096];
+        char line[LINE_LEN];
+        size_t line_len = 0;
+        ssize_t n;
+        int ok = 1;
+        int done;
+        int failed;
+
+        while ((n = read(fd, buf, sizeof(buf))) > 0) {
+                ssize_t i;
+                for (i = 0; i < n; i++) {
+                        if (buf[i] != '\n') {
+                                if (line_len < sizeof(line) - 1)
+                                        line[line_len++] = buf[i];
+                                continue;
+                        }
+                        line[line_len] = '\0';
+                        line_len = 0;
+                        if (line[0] == 'e'
+                        || (sscanf(line, "ok %d failed %d", &done, &failed) == 2 && failed))
+                                ok = 0;
+                }
+                fwrite(buf, 1, n, stdout);
+        }
+        return ok;
+}
+
+
+void usage(void)
+{
+        fprintf(stderr, "usage: daelc [-s socket] function [argument]\n"
+                        "       daelc [-s socket] -\n");
+        exit(1);
+}
@@ -0,0 +1,139 @@
+/*
+ * file: layout.c
+ * --------------
+ * The tiling layouts. They only compute rectangles from the client flags
+ * and the output size, apply_layout in dael.c sends them to the server.
+ */
+#include "dael.h"
+#include "config.h"
+
+
+void grow_layout_buffer(Dael_LayoutBuffer* buf)
+{
+        size_t capacity = (buf->capacity) ? buf->capacity * 2 : CLIENTS_PER_SLAB;
+        Dael_Client** clients = realloc(buf->clients, capacity * sizeof(*clients));
+        unsigned char* flags;
+        Dael_Rect* rects;
+
+        if (clients)
+                buf->clients = clients;
+        flags = realloc(buf->flags, capacity * sizeof(*flags));
+        if (flags)
+                buf->flags = flags;
+        rects = realloc(buf->rects, capacity * sizeof(*rects));
+        if (rects)
+                buf->rects = rects;
+
+        if (!clients || !flags || !rects)
+                die("failed to allocate layout buffer");
+        buf->capacity = capacity;
+}
+
+
+/*
+ * The layout functions below only do the geometry: given the LAYOUT_*
+ * flags of n clients in list order they write the rectangle of client i
+ * to out[i]. They do not touch the X server or any global state.
+ */
+
+/* the first tiled client is the master and takes the left side, the
+ * other tiled clients are stacked on the right */
+void layout_normal(const unsigned char* flags, size_t n, int w, int h,
+                   int master_size, Dael_Rect* out)
+{
+        size_t master = n;
+        size_t i;
+        int num_slaves = 0;
+        int mw;
+        int mh;
+        int cw;
+        int ch;
+        int total_height;
+        int extra_space;
+        int cy = 0;
+
+        for (i = 0; i < n; i++) {
+                if (flags[i] & LAYOUT_FLOATING)
+                        continue;
+                if (master == n)
+                        master = i;
+                else
+                        num_slaves++;
+        }
+
+        if (num_slaves == 0) {
+                layout_monocle(flags, n, w, h, out);
+                return;
+        }
+
+        /* master window takes left half of display */
+        mw = (w * master_size) / 100;
+        mh = h;
+        mw -= BORDER_SIZE * 2;
+        mh -= BORDER_SIZE * 2;
+        set_rect(&out[master], 0, 0, mw, mh, BORDER_SIZE);
+
+        cw = (w - mw) - BORDER_SIZE * 2;
+        total_height = h - (num_slaves * BORDER_SIZE * 2);
+        ch = total_height / num_slaves;
+        extra_space = total_height % num_slaves;
+        /* more slaves than fit, X does not take empty windows so they
+         * get a pixel each and run off the bottom */
+        if (ch < 1) {
+                ch = 1;
+                extra_space = 0;
+        }
+
+        for (i = master + 1; i < n; i++) {
+                int height = ch;
+
+                if (flags[i] & LAYOUT_FLOATING)
+                        continue;
+
+                if (extra_space > 0) {
+                        height += 1;
+                        extra_space--;
+                }
+                set_rect(&out[i], mw, cy, cw, height, BORDER_SIZE);
+                cy += height + (BORDER_SIZE * 2);
+        }
+
+        layout_floating(flags, n, w, h, out);
+}
+
+
+/* in monocle mode, the focused window is the master window
+ * and fills the entirety of the screen */
+void layout_monocle(const unsigned char* flags, size_t n, int w, int h, Dael_Rect* out)
+{
+        size_t i;
+
+        for (i = 0; i < n; i++)
+                if (!(flags[i] & LAYOUT_FLOATING))
+                        set_rect(&out[i], 0, 0, w, h, 0);
+
+        layout_floating(flags, n, w, h, out);
+}
+
+
+/* for dialog windows */
+void layout_floating(const unsigned char* flags, size_t n, int w, int h, Dael_Rect* out)
+{
+        size_t i;
+
+        for (i = 0; i < n; i++)
+                if (flags[i] & LAYOUT_FLOATING)
+                        set_rect(&out[i], w / 2 - FLOAT_WIDTH / 2,
+                                 h / 2 - FLOAT_HEIGHT / 2,
+                                 FLOAT_WIDTH, FLOAT_HEIGHT, BORDER_SIZE);
+}
+
+
+void set_rect(Dael_Rect* r, int x, int y, int w, int h, int border_width)
+{
+        r->x = x;
+        r->y = y;
+        r->w = w;
+        r->h = h;
+        r->border_width = border_width;
+}
@@ -0,0 +1,100 @@
+/*
+ * file: main.c
+ * ------------
+ * Starts dael on $DISPLAY, or replays a trace, see usage.
+ */
+#include "dael.h"
+
+
+int main(int argc, char* argv[])
+{
+        const char* trace_path = NULL;
+        const char* replay_path = NULL;
+        bool paced = false;
+        int i;
+
+        for (i = 1; i < argc; i++) {
+                if (!strcmp(argv[i], "-t") && i + 1 < argc)
+                        trace_path = argv[++i];
+                else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+                        replay_path = argv[++i];
+                else if (!strcmp(argv[i], "-p") && replay_path)
+                        paced = true;
+                else
+                        usage();
+        }
+
+        dael_argv = argv;
+        XSetErrorHandler(xerror_handler);
+        Dael_State_init(&wm);
+        setup_event_handlers();
+        setup_keys();
+        setup_ewmh();
+        XFlush(wm.dpy);
+        XSync(wm.dpy, False);
+        wm.running = true;
+
+        /* after a restart pick the old state back up first, anything
+         * mapped in the meantime is then adopted as usual */
+        restore_state();
+        update_monitors();
+        adopt_existing_windows();
+        apply_pending_layout();
+        update_desktops();
+        XFlush(wm.dpy);
+
+        if (replay_path) {
+                /* no signalfd, a replay can be interrupted as usual */
+                wm.replaying = true;
+                reset_stats();
+                i = replay_trace(replay_path, paced);
+                print_stats(stdout);
+                Dael_State_free(&wm);
+                return i;
+        }
+
+        setup_signals();
+        reset_stats();
+
+        setup_control();
+        if (trace_path)
+                open_trace(trace_path);
+
+
+        while (wm.running) {
+                XEvent e;
+
+                /* drain whatever has arrived so a burst of events and
+                 * control commands costs one layout and one flush */
+                while (wm.running && XEventsQueued(wm.dpy, QueuedAfterReading)) {
+                        XNextEvent(wm.dpy, &e);
+                        handle_event(&e);
+                }
+                if (wm.trace && wm.trace->pending) {
+                        trace_event(NULL, TRACE_BATCH_END);
+                        flush_trace();
+                }
+
+                apply_pending_layout();
+                update_desktops();
+                XFlush(wm.dpy);
+                wm.stats.flushes++;
+
+                if (wm.running && !XEventsQueued(wm.dpy, QueuedAlready))
+                        wait_for_input();
+        }
+
+        close_control();
+        close_trace();
+        print_stats(stderr);
+        Dael_State_free(&wm);
+        return 0;
+}
+
+
+void usage(void)
+{
+        fprintf(stderr, "usage: dael [-t trace]\n"
+                        "       dael -r trace [-p]\n");
+        exit(1);
+}
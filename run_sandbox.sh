@@ -1,6 +1,18 @@
 set -e
 make clean
 make
+# HEADLESS=1 runs dael on a virtual framebuffer instead of a window, for
+# driving it with daelc and reading the stats (see README)
+if [ -n "$HEADLESS" ]; then
+    XVFB=$(whereis -b Xvfb | cut -f2 -d' ')
+    xinit ./xinitrc -- \
+        "$XVFB" \
+            :100 \
+            -ac \
+            -noreset \
+            -screen 0 1280x720x24
+    exit
+fi
 XEPHYR=$(whereis -b Xephyr | cut -f2 -d' ')
 xinit ./xinitrc -- \
     "$XEPHYR" \
@@ -0,0 +1,58 @@
+/*
+ * file: runtime.c
+ * ---------------
+ * The per-user, per-display runtime directory, shared by dael and its
+ * tools so they always agree on where the socket and statistics are.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "runtime.h"
+
+
+/*
+ * Path of a per-user, per-display file: $XDG_RUNTIME_DIR/dael/DISPLAY
+ * followed by suffix, or /tmp/dael-UID/DISPLAY... without
+ * XDG_RUNTIME_DIR. The directory is created private to the user, and an
+ * existing one is refused unless it is a real directory of the user that
+ * nobody else can get into. Returns 0 on failure.
+ */
+int runtime_path(char* buf, size_t len, const char* suffix)
+{
+        const char* base = getenv("XDG_RUNTIME_DIR");
+        const char* display = getenv("DISPLAY");
+        char dir[PATH_LEN];
+        struct stat st;
+        char* p;
+        int n;
+
+        if (base && *base)
+                n = snprintf(dir, sizeof(dir), "%s/dael", base);
+        else
+                n = snprintf(dir, sizeof(dir), "/tmp/dael-%lu", (unsigned long) getuid());
+        if (n < 0 || (size_t) n >= sizeof(dir))
+                return 0;
+
+        if (mkdir(dir, S_IRWXU) < 0 && errno != EEXIST) {
+                perror(dir);
+                return 0;
+        }
+        if (lstat(dir, &st) < 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid()
+        || (st.st_mode & (S_IRWXG | S_IRWXO))) {
+                fprintf(stderr, "dael: %s is not a private directory\n", dir);
+                return 0;
+        }
+
+        n = snprintf(buf, len, "%s/%s%s", dir, display ? display : "", suffix);
+        if (n < 0 || (size_t) n >= len)
+                return 0;
+        /* DISPLAY may be a path itself on some systems */
+        for (p = buf + strlen(dir) + 1; *p; p++)
+                if (*p == '/')
+                        *p = '_';
+        return 1;
+}
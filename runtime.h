@@ -0,0 +1,16 @@
+/*
+ * file: runtime.h
+ * ---------------
+ * Where dael, daelc and daelbench find the files of the dael running on
+ * $DISPLAY, see runtime_path.
+ */
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <stddef.h>
+
+#define PATH_LEN 256
+
+int runtime_path(char* buf, size_t len, const char* suffix);
+
+#endif
@@ -0,0 +1,1463 @@
+/*
+ * file: test.c
+ * ------------
+ * daeltest, built and run by `make check`. Needs no X server: it checks
+ * the layout functions and runs dael's event handlers against a fake
+ * backend.
+ *
+ * usage: daeltest -l
+ *        daeltest -b count [-w windows]
+ */
+#include "dael.h"
+#include "config.h"
+
+/* the screen the fake backend reports, and how many windows run_fake
+ * keeps open at most unless told otherwise */
+#define FAKE_WIDTH 1920
+#define FAKE_HEIGHT 1080
+#define FAKE_WINDOWS 16
+
+/* a fake window id is a serial number above its slot in the window table */
+#define FAKE_SLOT_BITS 16
+#define FAKE_SLOTS (1 << FAKE_SLOT_BITS)
+
+/* messages sent to the fake clients that they have not reacted to yet */
+#define FAKE_QUEUE 256
+
+/* daeltest -l checks every layout of up to this many clients, and times
+ * about LAYOUT_BENCH_RECTS rectangles per client count */
+#define LAYOUT_CHECK_MAX 40
+#define LAYOUT_BENCH_RECTS 10000000L
+
+/* lookups bench_lookups times, whatever the number of windows */
+#define LOOKUP_BENCH_COUNT 10000000L
+
+/* key presses bench_dispatch times per table size, cycling through
+ * DISPATCH_BENCH_KEYS of them */
+#define DISPATCH_BENCH_PRESSES 10000000L
+#define DISPATCH_BENCH_KEYS 4096
+#define DISPATCH_BENCH_MAX 10000
+
+/* commands bench_control sends, in writes of CONTROL_BENCH_BLOCK lines */
+#define CONTROL_BENCH_COMMANDS 1000000L
+#define CONTROL_BENCH_BLOCK 64
+
+/* bench_held_key holds increase_size down this long at each repeat rate,
+ * in real time since the layouts are held back by the clock */
+#define HELD_BENCH_MS 500
+
+/* launches bench_launch times, with and without this much more memory
+ * in use */
+#define LAUNCH_BENCH_COUNT 200
+#define LAUNCH_BENCH_BALLAST (512L * 1024 * 1024)
+
+/* how the client behind a fake window behaves, by its serial number */
+typedef enum {
+        FAKE_PLAIN,    /* sets no properties, can only be killed */
+        FAKE_POLITE,   /* answers pings and closes on WM_DELETE_WINDOW */
+        FAKE_DIALOG,   /* a polite dialog, floats and asks for sizes */
+        FAKE_STUBBORN, /* answers pings, ignores WM_DELETE_WINDOW */
+        FAKE_HUNG,     /* answers nothing */
+
+        FAKE_KINDS /* not a kind, just designates size of enum */
+} Fake_Kind;
+
+typedef struct Fake_Property Fake_Property;
+struct Fake_Property {
+        Atom name;
+        Atom type;
+        int format;
+        unsigned long n;     /* items, format 32 ones are stored as longs */
+        unsigned char* data;
+        Fake_Property* next;
+};
+
+/* a slot of the window table, free while id is None */
+typedef struct {
+        Window id;
+        Fake_Kind kind;
+        int live;            /* index into fake.live, -1 if not in it */
+        bool mapped;
+        int x;
+        int y;
+        int w;
+        int h;
+        int border_width;
+        Fake_Property* props;
+} Fake_Window;
+
+/* sent to a client, protocol is None for XKillClient */
+typedef struct {
+        Window win;
+        Atom protocol;
+} Fake_Message;
+
+/*
+ * The windows and properties of the fake server, and the clients behind
+ * them. Requests only change the table; what a client does in return is
+ * queued and done by fake_clients between operations, never from inside
+ * a request.
+ */
+typedef struct {
+        Fake_Window* windows;
+        int* free_slots;
+        int free_count;
+        int slot_count;      /* slots taken from the table so far */
+        unsigned long serial;
+        Window* live;        /* the load run's windows */
+        int live_count;
+        int live_max;
+        Fake_Message queue[FAKE_QUEUE];
+        int queued;
+        char host[256];      /* WM_CLIENT_MACHINE of the clients */
+        unsigned long requests; /* stands in for NextRequest */
+        unsigned long configure_notifies; /* geometry changes of the windows */
+        unsigned long pings;
+        unsigned long deletes;
+        unsigned long kills;
+        unsigned long dropped;  /* messages lost to a full queue */
+        unsigned long maps;
+        unsigned long map_round_trips; /* made while handling the MapRequests */
+} Fake_Server;
+
+int run_fake(unsigned long count, int windows);
+int bench_lookups(void);
+int bench_control(void);
+void bench_held_key(void);
+int bench_launch(void);
+void count_sigterm(int sig);
+void map_fake_window(void);
+void destroy_fake_window(Window win);
+void configure_request(Window win, unsigned long i);
+void toggle_fullscreen(Window win);
+void change_protocols(Window win);
+void expire_timers(void);
+void fake_clients(void);
+int check_layouts(void);
+int check_normal(const unsigned char* flags, size_t n, int w, int h, int master_size);
+int check_rect(const char* what, size_t n, size_t i, const Dael_Rect* r,
+               int x, int y, int w, int h, int border_width);
+void bench_layouts(void);
+int bench_dispatch(void);
+void count_key(const char* arg);
+
+void init_fake_state(Dael_State* state);
+void fake_init(int live_max);
+void fake_free(void);
+Window fake_create(Fake_Kind kind);
+void fake_destroy(Window win);
+Fake_Window* fake_lookup(Window win);
+Fake_Property* fake_find_property(Fake_Window* w, Atom name);
+void fake_put_property(Window win, Atom prop, Atom type, int format, int mode,
+                       const unsigned char* data, int n);
+void fake_geometry(Window win, int x, int y, int w, int h, int border_width);
+
+void fake_window(Window win);
+void fake_map(Window win);
+void fake_unmap(Window win);
+void fake_move(Window win, int x, int y);
+void fake_move_resize(Window win, int x, int y, unsigned int w, unsigned int h);
+void fake_configure(Window win, unsigned int mask, XWindowChanges* wc);
+void fake_set_border(Window win, unsigned int value);
+void fake_set_border_color(Window win, unsigned long color);
+void fake_select_input(Window win, long mask);
+void fake_change_property(Window win, Atom prop, Atom type, int format, int mode,
+                          const unsigned char* data, int n);
+void fake_delete_property(Window win, Atom prop);
+int fake_get_property(Window win, Atom prop, long offset, long length, Bool del,
+                      Atom req_type, Atom* type, int* format, unsigned long* n,
+                      unsigned long* remaining, unsigned char** data);
+void fake_send_event(Window win, long mask, XEvent* e);
+void fake_kill_client(Window win);
+void fake_server(void);
+int fake_screen_width(void);
+int fake_screen_height(void);
+unsigned long fake_next_request(void);
+
+/* an in-memory server with windows and properties, see Fake_Server */
+static const Dael_Backend fake_backend = {
+        fake_map,
+        fake_unmap,
+        fake_move,
+        fake_move_resize,
+        fake_configure,
+        fake_set_border,
+        fake_set_border_color,
+        fake_window,
+        fake_window,
+        fake_select_input,
+        fake_change_property,
+        fake_delete_property,
+        fake_get_property,
+        fake_send_event,
+        fake_kill_client,
+        fake_server,
+        fake_server,
+        fake_screen_width,
+        fake_screen_height,
+        fake_next_request
+};
+
+Fake_Server fake;
+
+/* _NET_WM_PID of the fake clients is daeltest itself, so the SIGTERM
+ * stage of kill_window ends up here */
+volatile sig_atomic_t fake_sigterms;
+
+/* key presses that reached their binding in bench_dispatch */
+unsigned long dispatched;
+
+
+int main(int argc, char* argv[])
+{
+        int windows = FAKE_WINDOWS;
+
+        if (argc == 2 && !strcmp(argv[1], "-l"))
+                return check_layouts();
+        if (argc == 5 && !strcmp(argv[3], "-w")) {
+                windows = atoi(argv[4]);
+                /* the root window takes a slot too */
+                if (windows < 1 || windows >= FAKE_SLOTS)
+                        usage();
+                argc = 3;
+        }
+        if (argc == 3 && !strcmp(argv[1], "-b"))
+                return run_fake(strtoul(argv[2], NULL, 10), windows);
+        usage();
+        return 1;
+}
+
+
+void usage(void)
+{
+        fprintf(stderr, "usage: daeltest -l\n"
+                        "       daeltest -b count [-w windows]\n");
+        exit(1);
+}
+
+
+/*
+ * Runs count synthetic operations through the event handlers and the
+ * layout against the fake backend, each followed by what the clients do
+ * in return and by the work the main loop does after a batch: maps and
+ * destroys, focus changes, resizes, ConfigureRequests, kill_window,
+ * expired pings and kills, fullscreen requests, WM_PROTOCOLS changes and
+ * workspace switches.
+ * The clients come in every Fake_Kind, at most windows of them at a
+ * time. Prints the throughput and the statistics, then runs the benches
+ * that need the windows, and fails if a bench goes wrong or if any
+ * client or window is left once every window is gone.
+ */
+int run_fake(unsigned long count, int windows)
+{
+        struct sigaction sa;
+        struct timespec start;
+        struct timespec end;
+        double secs;
+        unsigned long i;
+        Window win;
+        int failed = 0;
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = count_sigterm;
+        sigaction(SIGTERM, &sa, NULL);
+
+        fake_init(windows);
+        init_fake_state(&wm);
+        setup_event_handlers();
+        update_monitors();
+        apply_pending_layout();
+        reset_stats();
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < count; i++) {
+                /* not always the newest, so the master and the focused
+                 * window get their turn too */
+                win = (fake.live_count) ? fake.live[i % fake.live_count] : None;
+
+                switch (i % 8) {
+                case 0:
+                case 4:
+                        if (fake.live_count < fake.live_max) {
+                                map_fake_window();
+                                break;
+                        }
+                        /* fall through */
+                case 3:
+                        if (win)
+                                destroy_fake_window(win);
+                        break;
+                case 1:
+                        focus_next(NULL);
+                        break;
+                case 2:
+                        if (i % 64 == 2)
+                                cycle_tiling_mode(NULL);
+                        else if (i % 16 == 2)
+                                increase_size(NULL);
+                        else
+                                decrease_size(NULL);
+                        break;
+                case 5:
+                        if (win)
+                                configure_request(win, i);
+                        break;
+                case 6:
+                        kill_window(NULL);
+                        break;
+                default:
+                        if (i / 8 % 4 == 0)
+                                expire_timers();
+                        else if (i / 8 % 4 == 1 && win)
+                                toggle_fullscreen(win);
+                        else if (i / 8 % 4 == 2 && win)
+                                change_protocols(win);
+                        else if (i / 32 % 4 == 0)
+                                append_workspace(NULL);
+                        else if (i / 32 % 4 == 2)
+                                prev_workspace(NULL);
+                        else
+                                focus_prev(NULL);
+                        break;
+                }
+                fake_clients();
+                apply_pending_layout();
+                update_desktops();
+
+                /* memory has to stay flat however long the run */
+                if (count >= 10 && (i + 1) % (count / 10) == 0)
+                        printf("soak ops %lu clients %lu slabs %lu workspaces %lu slabs %lu"
+                               " rss_kb %ld\n", i + 1,
+                               wm.client_pool.in_use, wm.client_pool.slab_count,
+                               wm.workspace_pool.in_use, wm.workspace_pool.slab_count,
+                               resident_kb());
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        failed = bench_lookups();
+        failed |= bench_control();
+        bench_held_key();
+        failed |= bench_launch();
+
+        while (fake.live_count)
+                destroy_fake_window(fake.live[fake.live_count - 1]);
+        fake_clients();
+        apply_pending_layout();
+
+        secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("%lu operations in %.3f s, %.0f ops/s\n", count, secs,
+               secs > 0 ? count / secs : 0.0);
+        printf("fake pings %lu deletes %lu sigterms %d kills %lu configure_notifies %lu"
+               " dropped %lu round_trips_per_map %.2f\n", fake.pings, fake.deletes,
+               (int) fake_sigterms, fake.kills, fake.configure_notifies, fake.dropped,
+               fake.maps ? (double) fake.map_round_trips / fake.maps : 0.0);
+        print_stats(stdout);
+
+        if (wm.client_pool.in_use) {
+                fprintf(stderr, "daeltest: %lu clients leaked\n", wm.client_pool.in_use);
+                failed = 1;
+        }
+        /* only the root window is left */
+        if (fake.slot_count - fake.free_count != 1) {
+                fprintf(stderr, "daeltest: %d windows left\n",
+                        fake.slot_count - fake.free_count - 1);
+                failed = 1;
+        }
+        Dael_State_free(&wm);
+        fake_free();
+        return failed;
+}
+
+
+/*
+ * Maps windows up to the most the load run keeps open and times
+ * get_client on them, every other lookup a window that is not managed.
+ * The cost should not depend on the number of windows.
+ */
+int bench_lookups(void)
+{
+        struct timespec start;
+        struct timespec end;
+        long rounds;
+        long r;
+        long found = 0;
+        int i;
+
+        while (fake.live_count < fake.live_max)
+                map_fake_window();
+        fake_clients();
+        apply_pending_layout();
+
+        rounds = LOOKUP_BENCH_COUNT / (2 * fake.live_count);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (r = 0; r < rounds; r++) {
+                for (i = 0; i < fake.live_count; i++) {
+                        /* the same slot with a later serial */
+                        if (get_client(fake.live[i]))
+                                found++;
+                        if (get_client(fake.live[i] + FAKE_SLOTS))
+                                found--;
+                }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        printf("lookup_bench windows %d ns_per_lookup %.2f\n", fake.live_count,
+               ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec))
+               / (2.0 * rounds * fake.live_count));
+        if (found != rounds * fake.live_count) {
+                fprintf(stderr, "daeltest: get_client found %ld of %ld windows\n",
+                        found, rounds * fake.live_count);
+                return 1;
+        }
+        return 0;
+}
+
+
+/*
+ * Commands per second through read_control from a socket, first one per
+ * line and then in begin/end blocks of CONTROL_BENCH_BLOCK, each write
+ * followed by the layout the main loop would do. The replies are read
+ * and thrown away.
+ */
+int bench_control(void)
+{
+        static const char* lines[] = {
+                "focus_next\n", "increase_size\n", "swap_master\n", "decrease_size\n"
+        };
+        static Dael_ControlConn conn;
+        char text[CONTROL_BUFSIZE];
+        char reply[CONTROL_BUFSIZE];
+        struct timespec start;
+        struct timespec end;
+        unsigned long layouts;
+        size_t len;
+        double secs;
+        long rounds = CONTROL_BENCH_COMMANDS / CONTROL_BENCH_BLOCK;
+        long r;
+        int sv[2];
+        int block;
+        int i;
+
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+                perror("daeltest: socketpair");
+                return 1;
+        }
+        conn.fd = sv[0];
+        conn.len = 0;
+
+        for (block = 0; block < 2; block++) {
+                len = 0;
+                if (block)
+                        len += sprintf(text + len, "begin\n");
+                for (i = 0; i < CONTROL_BENCH_BLOCK; i++)
+                        len += sprintf(text + len, "%s", lines[i % 4]);
+                if (block)
+                        len += sprintf(text + len, "end\n");
+
+                layouts = 0;
+                for (i = 0; i < MODE_COUNT; i++)
+                        layouts -= wm.stats.layouts[i].count;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                for (r = 0; r < rounds; r++) {
+                        if (write(sv[1], text, len) != (ssize_t) len) {
+                                perror("daeltest: control");
+                                close(sv[0]);
+                                close(sv[1]);
+                                return 1;
+                        }
+                        read_control(&conn);
+                        apply_pending_layout();
+                        update_desktops();
+                        while (recv(sv[1], reply, sizeof(reply), MSG_DONTWAIT) > 0);
+                }
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                for (i = 0; i < MODE_COUNT; i++)
+                        layouts += wm.stats.layouts[i].count;
+
+                secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+                printf("control_bench %s commands %ld commands_per_s %.0f layouts_per_write %.2f\n",
+                       block ? "block" : "lines", rounds * CONTROL_BENCH_BLOCK,
+                       secs > 0 ? rounds * CONTROL_BENCH_BLOCK / secs : 0.0,
+                       (double) layouts / rounds);
+        }
+        close(sv[0]);
+        close(sv[1]);
+        return 0;
+}
+
+
+/*
+ * Layouts per second while increase_size autorepeats, at a few repeat
+ * rates, with the main loop's part done between the repeats: the held
+ * back layout runs once its timer is due. Without the rate limit every
+ * repeat would be a layout.
+ */
+void bench_held_key(void)
+{
+        static const int rates[] = { 25, 50, 100 };
+        static Dael_Keybinding binding[2];
+        struct timespec now;
+        struct timespec next;
+        struct timespec pause;
+        unsigned long layouts;
+        long period;
+        long left;
+        int repeats;
+        int delay;
+        size_t r;
+        int i;
+        XEvent e;
+
+        binding[0].func = increase_size;
+        binding[0].key_sym = XK_a;
+        binding[1].key_sym = NoSymbol;
+        key_bindings = binding;
+        key_table[1][0] = 1;
+        wm.current_workspace->mode = NORMAL;
+
+        memset(&e, 0, sizeof(e));
+        e.xkey.keycode = 1;
+        for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+                period = 1000000000L / rates[r];
+                layouts = 0;
+                for (i = 0; i < MODE_COUNT; i++)
+                        layouts -= wm.stats.layouts[i].count;
+
+                clock_gettime(CLOCK_MONOTONIC, &next);
+                e.type = KeyPress;
+                for (repeats = 0; repeats < rates[r] * HELD_BENCH_MS / 1000; repeats++) {
+                        handle_event(&e);
+                        next.tv_nsec += period;
+                        while (next.tv_nsec >= 1000000000L) {
+                                next.tv_sec++;
+                                next.tv_nsec -= 1000000000L;
+                        }
+                        /* until the next repeat, waking up for the
+                         * held back layout */
+                        for (;;) {
+                                run_timers();
+                                apply_pending_layout();
+                                clock_gettime(CLOCK_MONOTONIC, &now);
+                                left = (next.tv_sec - now.tv_sec) * 1000L
+                                       + (next.tv_nsec - now.tv_nsec) / 1000000L;
+                                delay = layout_delay();
+                                if (delay <= 0 || delay >= left)
+                                        break;
+                                pause.tv_sec = 0;
+                                pause.tv_nsec = delay * 1000000L;
+                                nanosleep(&pause, NULL);
+                        }
+                        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR);
+                }
+                e.type = KeyRelease;
+                handle_event(&e);
+                apply_pending_layout();
+
+                for (i = 0; i < MODE_COUNT; i++)
+                        layouts += wm.stats.layouts[i].count;
+                printf("held_key_bench repeats_per_s %d layouts_per_s %.0f\n", rates[r],
+                       layouts * 1000.0 / HELD_BENCH_MS);
+        }
+
+        key_table[1][0] = 0;
+        key_bindings = config_keys;
+}
+
+
+/*
+ * How long launch_program keeps dael busy, and how long until the
+ * program has run and exited, once as small as dael is and once with
+ * LAUNCH_BENCH_BALLAST more memory in use, whose page tables a fork
+ * would have to copy.
+ */
+int bench_launch(void)
+{
+        struct timespec start;
+        struct timespec spawned;
+        struct timespec end;
+        double stall_us;
+        double exit_us;
+        char* ballast = NULL;
+        int big;
+        int i;
+
+        for (big = 0; big < 2; big++) {
+                if (big) {
+                        if (!(ballast = malloc(LAUNCH_BENCH_BALLAST)))
+                                break;
+                        memset(ballast, 1, LAUNCH_BENCH_BALLAST);
+                }
+                stall_us = 0;
+                exit_us = 0;
+                for (i = 0; i < LAUNCH_BENCH_COUNT; i++) {
+                        clock_gettime(CLOCK_MONOTONIC, &start);
+                        launch_program("true");
+                        clock_gettime(CLOCK_MONOTONIC, &spawned);
+                        if (waitpid(-1, NULL, 0) < 0) {
+                                perror("daeltest: launch");
+                                free(ballast);
+                                return 1;
+                        }
+                        clock_gettime(CLOCK_MONOTONIC, &end);
+                        stall_us += (spawned.tv_sec - start.tv_sec) * 1e6
+                                    + (spawned.tv_nsec - start.tv_nsec) / 1e3;
+                        exit_us += (end.tv_sec - start.tv_sec) * 1e6
+                                   + (end.tv_nsec - start.tv_nsec) / 1e3;
+                }
+                printf("launch_bench rss_kb %ld stall_us %.1f exit_us %.1f\n", resident_kb(),
+                       stall_us / LAUNCH_BENCH_COUNT, exit_us / LAUNCH_BENCH_COUNT);
+        }
+        free(ballast);
+        return 0;
+}
+
+
+void count_sigterm(int sig)
+{
+        (void) sig;
+        fake_sigterms++;
+}
+
+
+/* a new window of the next kind, with the properties its client would
+ * set before mapping it */
+void map_fake_window(void)
+{
+        Fake_Kind kind = (Fake_Kind) ((fake.serial + 1) % FAKE_KINDS);
+        Window win = fake_create(kind);
+        Fake_Window* w = fake_lookup(win);
+        long protocols[2];
+        long pid = getpid();
+        long type = wm.atoms[ATOM_NET_WM_WINDOW_TYPE_DIALOG];
+        unsigned long round_trips = wm.stats.round_trips;
+        XEvent e;
+
+        if (!win)
+                return;
+        if (kind != FAKE_PLAIN) {
+                protocols[0] = wm.atoms[ATOM_WM_DELETE_WINDOW];
+                protocols[1] = wm.atoms[ATOM_NET_WM_PING];
+                fake_put_property(win, wm.atoms[ATOM_WM_PROTOCOLS], XA_ATOM, 32,
+                                  PropModeReplace, (unsigned char*) protocols, 2);
+                fake_put_property(win, wm.atoms[ATOM_NET_WM_PID], XA_CARDINAL, 32,
+                                  PropModeReplace, (unsigned char*) &pid, 1);
+                fake_put_property(win, XA_WM_CLIENT_MACHINE, XA_STRING, 8,
+                                  PropModeReplace, (unsigned char*) fake.host,
+                                  strlen(fake.host));
+        }
+        if (kind == FAKE_DIALOG)
+                fake_put_property(win, wm.atoms[ATOM_NET_WM_WINDOW_TYPE], XA_ATOM, 32,
+                                  PropModeReplace, (unsigned char*) &type, 1);
+
+        w->live = fake.live_count;
+        fake.live[fake.live_count++] = win;
+
+        memset(&e, 0, sizeof(e));
+        e.type = MapRequest;
+        e.xmaprequest.parent = wm.root;
+        e.xmaprequest.window = win;
+        handle_event(&e);
+        fake.maps++;
+        fake.map_round_trips += wm.stats.round_trips - round_trips;
+}
+
+
+void destroy_fake_window(Window win)
+{
+        XEvent e;
+
+        fake_destroy(win);
+        memset(&e, 0, sizeof(e));
+        e.type = DestroyNotify;
+        e.xdestroywindow.event = wm.root;
+        e.xdestroywindow.window = win;
+        handle_event(&e);
+}
+
+
+/* a new size, every other time a new position too; the fields that are
+ * not asked for carry the current geometry like the server's */
+void configure_request(Window win, unsigned long i)
+{
+        Fake_Window* w = fake_lookup(win);
+        XEvent e;
+
+        memset(&e, 0, sizeof(e));
+        e.type = ConfigureRequest;
+        e.xconfigurerequest.parent = wm.root;
+        e.xconfigurerequest.window = win;
+        e.xconfigurerequest.x = w->x;
+        e.xconfigurerequest.y = w->y;
+        e.xconfigurerequest.width = 200 + i % 400;
+        e.xconfigurerequest.height = 150 + i % 300;
+        e.xconfigurerequest.border_width = w->border_width;
+        e.xconfigurerequest.value_mask = CWWidth | CWHeight;
+        if (i / 8 % 2) {
+                e.xconfigurerequest.x = i % 500;
+                e.xconfigurerequest.y = i % 300;
+                e.xconfigurerequest.value_mask |= CWX | CWY;
+        }
+        handle_event(&e);
+}
+
+
+void toggle_fullscreen(Window win)
+{
+        XEvent e;
+
+        memset(&e, 0, sizeof(e));
+        e.type = ClientMessage;
+        e.xclient.window = win;
+        e.xclient.message_type = wm.atoms[ATOM_NET_WM_STATE];
+        e.xclient.format = 32;
+        e.xclient.data.l[0] = NET_WM_STATE_TOGGLE;
+        e.xclient.data.l[1] = wm.atoms[ATOM_NET_WM_STATE_FULLSCREEN];
+        handle_event(&e);
+}
+
+
+/* sets WM_PROTOCOLS again, which drops dael's cached copy */
+void change_protocols(Window win)
+{
+        Fake_Window* w = fake_lookup(win);
+        Fake_Property* p = fake_find_property(w, wm.atoms[ATOM_WM_PROTOCOLS]);
+        XEvent e;
+
+        if (!p)
+                return;
+        fake_put_property(win, p->name, p->type, p->format, PropModeReplace,
+                          p->data, p->n);
+        memset(&e, 0, sizeof(e));
+        e.type = PropertyNotify;
+        e.xproperty.window = win;
+        e.xproperty.atom = wm.atoms[ATOM_WM_PROTOCOLS];
+        e.xproperty.state = PropertyNewValue;
+        handle_event(&e);
+}
+
+
+/* as if PING_TIMEOUT and KILL_TIMEOUT had passed for every client */
+void expire_timers(void)
+{
+        static const struct timespec past;
+        Dael_Workspace* ws;
+        Dael_Client* c;
+        int i;
+
+        for (i = 0; i < MAX_TIMERS; i++)
+                wm.timers[i].when = past;
+        for (ws = wm.workspaces; ws; ws = ws->next) {
+                for (c = ws->clients; c; c = c->next) {
+                        c->ping_deadline = past;
+                        c->kill_deadline = past;
+                }
+        }
+        run_timers();
+}
+
+
+/*
+ * The clients answer what they were sent: pings by all but the hung
+ * ones, WM_DELETE_WINDOW by closing for the polite ones, and a window
+ * whose client got killed goes away. Anything dael does in response may
+ * queue more.
+ */
+void fake_clients(void)
+{
+        int i;
+
+        for (i = 0; i < fake.queued; i++) {
+                Fake_Message* m = &fake.queue[i];
+                Fake_Window* w = fake_lookup(m->win);
+                XEvent e;
+
+                if (!w || w->live < 0)
+                        continue;
+                if (m->protocol == None) {
+                        fake.kills++;
+                        destroy_fake_window(m->win);
+                }
+                else if (m->protocol == wm.atoms[ATOM_WM_DELETE_WINDOW]) {
+                        if (w->kind != FAKE_POLITE && w->kind != FAKE_DIALOG)
+                                continue;
+                        fake.deletes++;
+                        destroy_fake_window(m->win);
+                }
+                else if (m->protocol == wm.atoms[ATOM_NET_WM_PING] && w->kind != FAKE_HUNG) {
+                        fake.pings++;
+                        memset(&e, 0, sizeof(e));
+                        e.type = ClientMessage;
+                        e.xclient.window = wm.root;
+                        e.xclient.message_type = wm.atoms[ATOM_WM_PROTOCOLS];
+                        e.xclient.format = 32;
+                        e.xclient.data.l[0] = wm.atoms[ATOM_NET_WM_PING];
+                        e.xclient.data.l[2] = m->win;
+                        handle_event(&e);
+                }
+        }
+        fake.queued = 0;
+}
+
+
+/*
+ * daeltest -l: checks the layout functions on edge cases and on every mix of
+ * up to LAYOUT_CHECK_MAX tiled and floating clients, then times them.
+ * Returns the number of failed checks.
+ */
+int check_layouts(void)
+{
+        unsigned char flags[LAYOUT_CHECK_MAX];
+        Dael_Rect out[LAYOUT_CHECK_MAX];
+        static const int sizes[][2] = { { 1920, 1080 }, { 1280, 719 }, { 101, 37 } };
+        int failed = 0;
+        size_t n;
+        size_t i;
+        size_t s;
+
+        /* a single client gets the whole screen without a border */
+        flags[0] = 0;
+        layout_normal(flags, 1, 1920, 1080, MASTER_DEFAULT, out);
+        failed += check_rect("single", 1, 0, &out[0], 0, 0, 1920, 1080, 0);
+
+        /* nothing tiled, every client is centered */
+        for (i = 0; i < 3; i++)
+                flags[i] = LAYOUT_FLOATING;
+        layout_normal(flags, 3, 1920, 1080, MASTER_DEFAULT, out);
+        for (i = 0; i < 3; i++)
+                failed += check_rect("all floating", 3, i, &out[i],
+                                     960 - FLOAT_WIDTH / 2, 540 - FLOAT_HEIGHT / 2,
+                                     FLOAT_WIDTH, FLOAT_HEIGHT, BORDER_SIZE);
+
+        /* the first tiled client is the master, even after a floating one */
+        flags[0] = LAYOUT_FLOATING;
+        flags[1] = 0;
+        flags[2] = 0;
+        layout_normal(flags, 3, 1000, 1000, 50, out);
+        failed += check_rect("floating first", 3, 1, &out[1], 0, 0,
+                             500 - 2 * BORDER_SIZE, 1000 - 2 * BORDER_SIZE, BORDER_SIZE);
+
+        /* 1000 - 3 * 2 * BORDER_SIZE does not split evenly, the first
+         * slaves get the remainder */
+        for (i = 0; i < 4; i++)
+                flags[i] = 0;
+        layout_normal(flags, 4, 1000, 1000, 50, out);
+        n = (1000 - 3 * 2 * BORDER_SIZE) % 3;
+        for (i = 1; i < 4; i++)
+                if (out[i].h != (1000 - 3 * 2 * BORDER_SIZE) / 3 + (i - 1 < n)) {
+                        fprintf(stderr, "extra_space: slave %lu is %d high\n",
+                                (unsigned long) i, out[i].h);
+                        failed++;
+                }
+
+        /* monocle covers the screen with every tiled client */
+        flags[0] = 0;
+        flags[1] = LAYOUT_FLOATING;
+        flags[2] = 0;
+        layout_monocle(flags, 3, 800, 600, out);
+        failed += check_rect("monocle", 3, 0, &out[0], 0, 0, 800, 600, 0);
+        failed += check_rect("monocle", 3, 2, &out[2], 0, 0, 800, 600, 0);
+
+        /* no clients, must not touch out */
+        layout_normal(flags, 0, 800, 600, 50, NULL);
+        layout_monocle(flags, 0, 800, 600, NULL);
+
+        /* every third, fifth or no client floating, at several sizes */
+        for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+                for (n = 1; n <= LAYOUT_CHECK_MAX; n++) {
+                        for (i = 0; i < n; i++)
+                                flags[i] = (i % 3 == 1) ? LAYOUT_FLOATING : 0;
+                        failed += check_normal(flags, n, sizes[s][0], sizes[s][1], MASTER_DEFAULT);
+                        for (i = 0; i < n; i++)
+                                flags[i] = (i % 5 == 0) ? LAYOUT_FLOATING : 0;
+                        failed += check_normal(flags, n, sizes[s][0], sizes[s][1], MASTER_MAX);
+                        memset(flags, 0, n);
+                        failed += check_normal(flags, n, sizes[s][0], sizes[s][1], MASTER_MIN);
+                }
+        }
+
+        printf("layout checks failed %d\n", failed);
+        bench_layouts();
+        failed += bench_dispatch();
+        return failed != 0;
+}
+
+
+/*
+ * The tiled clients of layout_normal have to cover the screen exactly:
+ * the master on the left, the slaves stacked on the right without gaps,
+ * their heights differing by at most one pixel. When the slaves do not
+ * fit each needs to be at least one pixel high.
+ */
+int check_normal(const unsigned char* flags, size_t n, int w, int h, int master_size)
+{
+        Dael_Rect out[LAYOUT_CHECK_MAX];
+        size_t master = n;
+        size_t tiled = 0;
+        int failed = 0;
+        int min_h = h;
+        int max_h = 0;
+        int y = 0;
+        bool fits;
+        size_t i;
+
+        layout_normal(flags, n, w, h, master_size, out);
+
+        for (i = 0; i < n; i++) {
+                const Dael_Rect* r = &out[i];
+
+                if (flags[i] & LAYOUT_FLOATING) {
+                        failed += check_rect("floating", n, i, r, w / 2 - FLOAT_WIDTH / 2,
+                                             h / 2 - FLOAT_HEIGHT / 2,
+                                             FLOAT_WIDTH, FLOAT_HEIGHT, BORDER_SIZE);
+                        continue;
+                }
+                tiled++;
+                if (master == n) {
+                        master = i;
+                        continue;
+                }
+                if (r->y != y || r->x != out[master].w
+                || r->x + r->w + 2 * r->border_width != w) {
+                        fprintf(stderr, "slave %lu of %lu at %d,%d %dx%d on %dx%d\n",
+                                (unsigned long) i, (unsigned long) n,
+                                r->x, r->y, r->w, r->h, w, h);
+                        failed++;
+                }
+                y += r->h + 2 * r->border_width;
+                min_h = MIN(min_h, r->h);
+                max_h = MAX(max_h, r->h);
+        }
+
+        fits = h - (int) (tiled - 1) * 2 * BORDER_SIZE >= (int) tiled - 1;
+        if (tiled == 1)
+                failed += check_rect("only tiled", n, master, &out[master], 0, 0, w, h, 0);
+        else if (tiled > 1
+             && (check_rect("master", n, master, &out[master], 0, 0,
+                            w * master_size / 100 - 2 * BORDER_SIZE,
+                            h - 2 * BORDER_SIZE, BORDER_SIZE)
+                 || min_h < 1 || (fits && (y != h || max_h - min_h > 1)))) {
+                fprintf(stderr, "%lu clients on %dx%d: slaves end at %d, heights %d-%d\n",
+                        (unsigned long) n, w, h, y, min_h, max_h);
+                failed++;
+        }
+        return failed;
+}
+
+
+int check_rect(const char* what, size_t n, size_t i, const Dael_Rect* r,
+               int x, int y, int w, int h, int border_width)
+{
+        if (r->x == x && r->y == y && r->w == w && r->h == h
+        && r->border_width == border_width)
+                return 0;
+        fprintf(stderr, "%s: client %lu of %lu at %d,%d %dx%d border %d,"
+                " expected %d,%d %dx%d border %d\n", what, (unsigned long) i,
+                (unsigned long) n, r->x, r->y, r->w, r->h, r->border_width,
+                x, y, w, h, border_width);
+        return 1;
+}
+
+
+/* time per layout from 10 to 10000 clients, every tenth one floating */
+void bench_layouts(void)
+{
+        Dael_LayoutBuffer buf = { 0 };
+        struct timespec start;
+        struct timespec end;
+        size_t n;
+        size_t i;
+        long rounds;
+        long r;
+        int mode;
+        double ns;
+
+        for (n = 10; n <= 10000; n *= 10) {
+                while (buf.capacity < n)
+                        grow_layout_buffer(&buf);
+                for (i = 0; i < n; i++)
+                        buf.flags[i] = (i % 10 == 9) ? LAYOUT_FLOATING : 0;
+                /* about the same number of rectangles for every size */
+                rounds = LAYOUT_BENCH_RECTS / n;
+
+                for (mode = 0; mode < MODE_COUNT; mode++) {
+                        clock_gettime(CLOCK_MONOTONIC, &start);
+                        for (r = 0; r < rounds; r++) {
+                                if (mode == MONOCLE)
+                                        layout_monocle(buf.flags, n, 1920, 1080, buf.rects);
+                                else
+                                        layout_normal(buf.flags, n, 1920, 1080,
+                                                      MASTER_DEFAULT, buf.rects);
+                        }
+                        clock_gettime(CLOCK_MONOTONIC, &end);
+                        ns = ((end.tv_sec - start.tv_sec) * 1e9
+                              + (end.tv_nsec - start.tv_nsec)) / rounds;
+                        printf("layout_bench %s clients %lu ns_per_layout %.0f ns_per_client %.2f\n",
+                               mode_names[mode], (unsigned long) n, ns, ns / n);
+                }
+        }
+        free(buf.clients);
+        free(buf.flags);
+        free(buf.rects);
+}
+
+
+/*
+ * Time per handle_key_press from 10 to 10000 bindings, pressing bound
+ * keys in no particular order. key_table is filled the way
+ * build_key_table fills it, every binding on its own keycode and
+ * modifiers, which needs no keyboard mapping.
+ */
+int bench_dispatch(void)
+{
+        static XEvent presses[DISPATCH_BENCH_KEYS];
+        Dael_Keybinding* bindings = malloc((DISPATCH_BENCH_MAX + 1) * sizeof(Dael_Keybinding));
+        struct timespec start;
+        struct timespec end;
+        unsigned long seed = 1;
+        size_t n;
+        size_t i;
+        size_t b;
+        long r;
+        int failed = 0;
+
+        if (!bindings)
+                die("failed to allocate the bindings");
+        key_bindings = bindings;
+
+        for (n = 10; n <= DISPATCH_BENCH_MAX; n *= 10) {
+                memset(key_table, 0, sizeof(key_table));
+                for (i = 0; i < n; i++) {
+                        /* clear of LockMask, which CLEANMASK drops */
+                        bindings[i].mod = (i / KEYCODE_COUNT) << 2;
+                        bindings[i].key_sym = XK_a;
+                        bindings[i].func = count_key;
+                        bindings[i].arg = NULL;
+                        key_table[i % KEYCODE_COUNT][bindings[i].mod] = i + 1;
+                }
+                bindings[n].key_sym = NoSymbol;
+
+                for (i = 0; i < DISPATCH_BENCH_KEYS; i++) {
+                        seed = seed * 1103515245 + 12345;
+                        b = (seed >> 16) % n;
+                        presses[i].type = KeyPress;
+                        presses[i].xkey.keycode = b % KEYCODE_COUNT;
+                        presses[i].xkey.state = bindings[b].mod;
+                }
+
+                dispatched = 0;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                for (r = 0; r < DISPATCH_BENCH_PRESSES; r++)
+                        handle_key_press(&presses[r % DISPATCH_BENCH_KEYS]);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+
+                printf("dispatch_bench bindings %lu ns_per_press %.2f\n", (unsigned long) n,
+                       ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec))
+                       / DISPATCH_BENCH_PRESSES);
+                if (dispatched != (unsigned long) DISPATCH_BENCH_PRESSES) {
+                        fprintf(stderr, "daeltest: %lu of %ld key presses dispatched\n",
+                                dispatched, DISPATCH_BENCH_PRESSES);
+                        failed = 1;
+                }
+        }
+
+        memset(key_table, 0, sizeof(key_table));
+        key_bindings = config_keys;
+        free(bindings);
+        return failed;
+}
+
+
+void count_key(const char* arg)
+{
+        (void) arg;
+        dispatched++;
+}
+
+
+/* a state without a display, for run_fake, on the fake server */
+void init_fake_state(Dael_State* state)
+{
+        int i;
+
+        state->dpy = NULL;
+        state->backend = &fake_backend;
+        state->root = fake_create(FAKE_PLAIN);
+        fake_geometry(state->root, 0, 0, FAKE_WIDTH, FAKE_HEIGHT, 0);
+        init_state(state);
+
+        /* any values do as long as they differ from each other and from
+         * the predefined atoms */
+        for (i = 0; i < ATOM_COUNT; i++)
+                state->atoms[i] = XA_LAST_PREDEFINED + 1 + i;
+}
+
+
+/* an empty server, for at most live_max windows of the load run */
+void fake_init(int live_max)
+{
+        memset(&fake, 0, sizeof(fake));
+        fake.windows = calloc(FAKE_SLOTS, sizeof(Fake_Window));
+        fake.free_slots = malloc(FAKE_SLOTS * sizeof(int));
+        fake.live = malloc(live_max * sizeof(Window));
+        if (!fake.windows || !fake.free_slots || !fake.live)
+                die("failed to allocate the fake server");
+        fake.live_max = live_max;
+        if (gethostname(fake.host, sizeof(fake.host)) < 0)
+                strcpy(fake.host, "localhost");
+        fake.host[sizeof(fake.host) - 1] = '\0';
+}
+
+
+void fake_free(void)
+{
+        int i;
+
+        for (i = 0; i < fake.slot_count; i++)
+                if (fake.windows[i].id)
+                        fake_destroy(fake.windows[i].id);
+        free(fake.windows);
+        free(fake.free_slots);
+        free(fake.live);
+        memset(&fake, 0, sizeof(fake));
+}
+
+
+/* None once every slot is taken */
+Window fake_create(Fake_Kind kind)
+{
+        Fake_Window* w;
+        int slot;
+
+        if (fake.free_count)
+                slot = fake.free_slots[--fake.free_count];
+        else if (fake.slot_count < FAKE_SLOTS)
+                slot = fake.slot_count++;
+        else
+                return None;
+
+        w = &fake.windows[slot];
+        memset(w, 0, sizeof(*w));
+        w->id = (++fake.serial << FAKE_SLOT_BITS) | slot;
+        w->kind = kind;
+        w->live = -1;
+        w->w = FLOAT_WIDTH;
+        w->h = FLOAT_HEIGHT;
+        return w->id;
+}
+
+
+void fake_destroy(Window win)
+{
+        Fake_Window* w = fake_lookup(win);
+        Fake_Property* p;
+
+        if (!w)
+                return;
+        while ((p = w->props)) {
+                w->props = p->next;
+                free(p->data);
+                free(p);
+        }
+        if (w->live >= 0) {
+                Window last = fake.live[--fake.live_count];
+                fake.live[w->live] = last;
+                fake_lookup(last)->live = w->live;
+        }
+        w->id = None;
+        fake.free_slots[fake.free_count++] = win & (FAKE_SLOTS - 1);
+}
+
+
+/* NULL for a window that does not exist (any more) */
+Fake_Window* fake_lookup(Window win)
+{
+        Fake_Window* w = &fake.windows[win & (FAKE_SLOTS - 1)];
+
+        return (win && w->id == win) ? w : NULL;
+}
+
+
+Fake_Property* fake_find_property(Fake_Window* w, Atom name)
+{
+        Fake_Property* p;
+
+        for (p = w->props; p && p->name != name; p = p->next);
+        return p;
+}
+
+
+/* XChangeProperty without counting a request, for the clients */
+void fake_put_property(Window win, Atom prop, Atom type, int format, int mode,
+                       const unsigned char* data, int n)
+{
+        Fake_Window* w = fake_lookup(win);
+        Fake_Property* p;
+        size_t item = (format == 32) ? sizeof(long) : (size_t) format / 8;
+        unsigned char* buf;
+        size_t old = 0;
+
+        if (!w || n < 0)
+                return;
+        if (!(p = fake_find_property(w, prop))) {
+                if (!(p = calloc(1, sizeof(*p))))
+                        die("failed to allocate a fake property");
+                p->name = prop;
+                p->next = w->props;
+                w->props = p;
+        }
+        /* appending to a property of another type or format replaces it */
+        if (mode != PropModeReplace && p->data && p->type == type && p->format == format)
+                old = p->n;
+
+        if (!(buf = malloc((old + n) * item + 1)))
+                die("failed to allocate a fake property");
+        if (old)
+                memcpy(buf + (mode == PropModePrepend ? n * item : 0), p->data, old * item);
+        if (n)
+                memcpy(buf + (mode == PropModePrepend ? 0 : old * item), data, n * item);
+        free(p->data);
+        p->data = buf;
+        p->n = old + n;
+        p->type = type;
+        p->format = format;
+}
+
+
+/* records a geometry change, the server would send a ConfigureNotify */
+void fake_geometry(Window win, int x, int y, int w, int h, int border_width)
+{
+        Fake_Window* fw = fake_lookup(win);
+
+        if (!fw || (fw->x == x && fw->y == y && fw->w == w && fw->h == h
+                    && fw->border_width == border_width))
+                return;
+        fw->x = x;
+        fw->y = y;
+        fw->w = w;
+        fw->h = h;
+        fw->border_width = border_width;
+        fake.configure_notifies++;
+}
+
+
+/* requests that change nothing the load run looks at only count,
+ * fake.requests stands in for NextRequest */
+void fake_window(Window win)
+{
+        (void) win;
+        fake.requests++;
+}
+
+
+void fake_map(Window win)
+{
+        Fake_Window* w = fake_lookup(win);
+
+        fake.requests++;
+        if (w)
+                w->mapped = true;
+}
+
+
+void fake_unmap(Window win)
+{
+        Fake_Window* w = fake_lookup(win);
+
+        fake.requests++;
+        if (w)
+                w->mapped = false;
+}
+
+
+void fake_move(Window win, int x, int y)
+{
+        Fake_Window* w = fake_lookup(win);
+
+        fake.requests++;
+        if (w)
+                fake_geometry(win, x, y, w->w, w->h, w->border_width);
+}
+
+
+void fake_move_resize(Window win, int x, int y, unsigned int w, unsigned int h)
+{
+        Fake_Window* fw = fake_lookup(win);
+
+        fake.requests++;
+        if (fw)
+                fake_geometry(win, x, y, w, h, fw->border_width);
+}
+
+
+void fake_configure(Window win, unsigned int mask, XWindowChanges* wc)
+{
+        Fake_Window* w = fake_lookup(win);
+
+        fake.requests++;
+        if (!w)
+                return;
+        fake_geometry(win, (mask & CWX) ? wc->x : w->x, (mask & CWY) ? wc->y : w->y,
+                      (mask & CWWidth) ? wc->width : w->w,
+                      (mask & CWHeight) ? wc->height : w->h,
+                      (mask & CWBorderWidth) ? wc->border_width : w->border_width);
+}
+
+
+void fake_set_border(Window win, unsigned int value)
+{
+        Fake_Window* w = fake_lookup(win);
+
+        fake.requests++;
+        if (w)
+                fake_geometry(win, w->x, w->y, w->w, w->h, value);
+}
+
+
+void fake_set_border_color(Window win, unsigned long color)
+{
+        (void) win;
+        (void) color;
+        fake.requests++;
+}
+
+
+void fake_select_input(Window win, long mask)
+{
+        (void) win;
+        (void) mask;
+        fake.requests++;
+}
+
+
+void fake_change_property(Window win, Atom prop, Atom type, int format, int mode,
+                          const unsigned char* data, int n)
+{
+        fake.requests++;
+        fake_put_property(win, prop, type, format, mode, data, n);
+}
+
+
+void fake_delete_property(Window win, Atom prop)
+{
+        Fake_Window* w = fake_lookup(win);
+        Fake_Property** pp;
+
+        fake.requests++;
+        if (!w)
+                return;
+        for (pp = &w->props; *pp && (*pp)->name != prop; pp = &(*pp)->next);
+        if (*pp) {
+                Fake_Property* p = *pp;
+                *pp = p->next;
+                free(p->data);
+                free(p);
+        }
+}
+
+
+/*
+ * XGetWindowProperty: offset and length count 32 bit units, the data is
+ * allocated (XFree is free) and terminated like Xlib's, and a type other
+ * than req_type only reports the type, format and size.
+ */
+int fake_get_property(Window win, Atom prop, long offset, long length, Bool del,
+                      Atom req_type, Atom* type, int* format, unsigned long* n,
+                      unsigned long* remaining, unsigned char** data)
+{
+        Fake_Window* w = fake_lookup(win);
+        Fake_Property* p;
+        unsigned long unit;
+        unsigned long bytes;
+        unsigned long start = (unsigned long) offset * 4;
+        unsigned long want;
+        size_t item;
+
+        fake.requests++;
+        *type = None;
+        *format = 0;
+        *n = 0;
+        *remaining = 0;
+        *data = NULL;
+        if (!w)
+                return BadWindow;
+        if (!(p = fake_find_property(w, prop)))
+                return Success;
+
+        *type = p->type;
+        *format = p->format;
+        unit = p->format / 8;
+        bytes = p->n * unit;
+        if (req_type != AnyPropertyType && req_type != p->type) {
+                *remaining = bytes;
+                return Success;
+        }
+        if (offset < 0 || start > bytes)
+                return BadValue;
+
+        want = bytes - start;
+        if ((unsigned long) length <= want / 4)
+                want = (unsigned long) length * 4;
+        want -= want % unit;
+        item = (p->format == 32) ? sizeof(long) : unit;
+        if (!(*data = malloc(want / unit * item + 1)))
+                die("failed to allocate a fake property");
+        memcpy(*data, p->data + start / unit * item, want / unit * item);
+        (*data)[want / unit * item] = '\0';
+        *n = want / unit;
+        *remaining = bytes - start - want;
+        if (del && !*remaining)
+                fake_delete_property(win, prop);
+        return Success;
+}
+
+
+/* the clients see WM_PROTOCOLS messages, in fake_clients */
+void fake_send_event(Window win, long mask, XEvent* e)
+{
+        (void) mask;
+        fake.requests++;
+        if (e->type != ClientMessage || e->xclient.message_type != wm.atoms[ATOM_WM_PROTOCOLS])
+                return;
+        if (fake.queued == FAKE_QUEUE) {
+                fake.dropped++;
+                return;
+        }
+        fake.queue[fake.queued].win = win;
+        fake.queue[fake.queued++].protocol = e->xclient.data.l[0];
+}
+
+
+void fake_kill_client(Window win)
+{
+        fake.requests++;
+        if (fake.queued == FAKE_QUEUE) {
+                fake.dropped++;
+                return;
+        }
+        fake.queue[fake.queued].win = win;
+        fake.queue[fake.queued++].protocol = None;
+}
+
+
+void fake_server(void)
+{
+        fake.requests++;
+}
+
+
+int fake_screen_width(void)
+{
+        return FAKE_WIDTH;
+}
+
+
+int fake_screen_height(void)
+{
+        return FAKE_HEIGHT;
+}
+
+
+unsigned long fake_next_request(void)
+{
+        return fake.requests;
+}